@@ -7,23 +7,231 @@
 
 #include "CLI.h"
 #include <algorithm>
+#include <chrono>
 #include <csignal>
 #include <cstdlib>
 #include <cstring>
+#include <deque>
 #include <exception>
+#include <future>
+#include <fcntl.h>
 #include <iostream>
 #include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <readline/history.h>
 #include <readline/readline.h>
-#include <sstream>
+#include <sys/socket.h>
+#include <sys/un.h>
 #include <thread>
 #include <unistd.h>
 
+#if defined(__linux__)
+#include <sys/eventfd.h>
+#endif
+
+// USDT 静态探针：现场会话卡住时 perf/bpftrace 可以直接挂接测量，
+// 未插桩时每个探针点只是一条 nop，开销为零。构建环境没有 systemtap
+// 头或未开启 CARLINK_ENABLE_SDT 时整层编译为空（见 CMakeLists.txt）。
+#if defined(CARLINK_HAVE_SDT)
+#include <sys/sdt.h>
+#define CARLINK_PROBE(name)            DTRACE_PROBE(carlink_cli, name)
+#define CARLINK_PROBE1(name, a1)       DTRACE_PROBE1(carlink_cli, name, a1)
+#define CARLINK_PROBE2(name, a1, a2)   DTRACE_PROBE2(carlink_cli, name, a1, a2)
+#else
+#define CARLINK_PROBE(name)            do {} while (0)
+#define CARLINK_PROBE1(name, a1)       do {} while (0)
+#define CARLINK_PROBE2(name, a1, a2)   do {} while (0)
+#endif
+
 namespace carlink {
 namespace cli {
 
+namespace {
+
+// 冻结树二进制文件：定宽头部 + 原样落盘的各数组
+// 布局：头部、节点数组、候选引用、子节点 key 引用、子节点下标、字符 arena
+struct FrozenTreeFileHeader {
+    char magic[8];
+    std::uint64_t version;
+    std::uint64_t nodeCount;
+    std::uint64_t candCount;
+    std::uint64_t childCount;
+    std::uint64_t arenaSize;
+};
+
+constexpr char FROZEN_TREE_MAGIC[8] = {'C', 'L', 'K', 'T', 'R', 'E', 'E', '\0'};
+// 版本 2 起要求每个节点的候选段按字典序存放（前缀匹配走二分）
+constexpr std::uint64_t FROZEN_TREE_VERSION = 2;
+
+bool writeAll(int fd, const void* data, size_t length)
+{
+    const char* p = static_cast<const char*>(data);
+    while (length > 0) {
+        ssize_t n = ::write(fd, p, length);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        p += n;
+        length -= n;
+    }
+    return true;
+}
+
+}   // namespace
+
+FrozenTree::~FrozenTree()
+{
+    if (mapBase_) {
+        ::munmap(mapBase_, mapSize_);
+    }
+}
+
+bool FrozenTree::dump(const std::string& path) const
+{
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+
+    FrozenTreeFileHeader header{};
+    memcpy(header.magic, FROZEN_TREE_MAGIC, sizeof(header.magic));
+    header.version = FROZEN_TREE_VERSION;
+    header.nodeCount = nodeCount_;
+    header.candCount = candCount_;
+    header.childCount = childCount_;
+    header.arenaSize = arenaSize_;
+
+    bool ok = writeAll(fd, &header, sizeof(header)) &&
+              writeAll(fd, nodeData_, nodeCount_ * sizeof(Node)) &&
+              writeAll(fd, candData_, candCount_ * sizeof(StrRef)) &&
+              writeAll(fd, childKeyData_, childCount_ * sizeof(StrRef)) &&
+              writeAll(fd, childNodeData_, childCount_ * sizeof(std::uint32_t)) &&
+              writeAll(fd, arenaData_, arenaSize_);
+
+    ::close(fd);
+    return ok;
+}
+
+std::shared_ptr<const FrozenTree> FrozenTree::load(const std::string& path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(FrozenTreeFileHeader)) {
+        ::close(fd);
+        return nullptr;
+    }
+
+    void* base = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);   // 映射建立后不再需要 fd
+    if (base == MAP_FAILED) {
+        return nullptr;
+    }
+
+    const auto* header = static_cast<const FrozenTreeFileHeader*>(base);
+    // 先用文件大小约束各计数，防止下面的尺寸等式在 64 位乘法里回绕
+    std::uint64_t sizeCap = st.st_size;
+    if (header->nodeCount > sizeCap / sizeof(Node) ||
+        header->candCount > sizeCap / sizeof(StrRef) ||
+        header->childCount > sizeCap / sizeof(StrRef) ||
+        header->arenaSize > sizeCap) {
+        ::munmap(base, st.st_size);
+        return nullptr;
+    }
+    size_t expected = sizeof(FrozenTreeFileHeader) +
+                      header->nodeCount * sizeof(Node) +
+                      header->candCount * sizeof(StrRef) +
+                      header->childCount * sizeof(StrRef) +
+                      header->childCount * sizeof(std::uint32_t) +
+                      header->arenaSize;
+    if (memcmp(header->magic, FROZEN_TREE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != FROZEN_TREE_VERSION ||
+        expected != (size_t)st.st_size) {
+        ::munmap(base, st.st_size);
+        return nullptr;
+    }
+
+    auto tree = std::make_shared<FrozenTree>();
+    tree->mapBase_ = base;
+    tree->mapSize_ = st.st_size;
+
+    // 各数组直接指向映射区，不做任何拷贝或解析
+    const char* cursor = static_cast<const char*>(base) + sizeof(FrozenTreeFileHeader);
+    tree->nodeData_ = reinterpret_cast<const Node*>(cursor);
+    tree->nodeCount_ = header->nodeCount;
+    cursor += header->nodeCount * sizeof(Node);
+    tree->candData_ = reinterpret_cast<const StrRef*>(cursor);
+    tree->candCount_ = header->candCount;
+    cursor += header->candCount * sizeof(StrRef);
+    tree->childKeyData_ = reinterpret_cast<const StrRef*>(cursor);
+    cursor += header->childCount * sizeof(StrRef);
+    tree->childNodeData_ = reinterpret_cast<const std::uint32_t*>(cursor);
+    tree->childCount_ = header->childCount;
+    cursor += header->childCount * sizeof(std::uint32_t);
+    tree->arenaData_ = cursor;
+    tree->arenaSize_ = header->arenaSize;
+
+    // 一次 O(n) 越界检查：头部的尺寸等式挡不住被截断后补齐或损坏的
+    // 文件，节点区间、子节点下标和字符串引用都可能指到映射之外，
+    // 后续查询会直接踩出映射（SIGBUS/SIGSEGV）。全部用 64 位算术
+    // 校验一遍再交付，合法文件只多付一次顺序扫描
+    auto refOk = [&](const StrRef& ref) {
+        return std::uint64_t(ref.offset) + ref.length <= tree->arenaSize_;
+    };
+    for (std::size_t i = 0; i < tree->nodeCount_; ++i) {
+        const Node& n = tree->nodeData_[i];
+        if (n.candBegin > n.candEnd || n.candEnd > tree->candCount_ ||
+            n.childBegin > n.childEnd || n.childEnd > tree->childCount_) {
+            return nullptr;
+        }
+    }
+    for (std::size_t i = 0; i < tree->candCount_; ++i) {
+        if (!refOk(tree->candData_[i])) {
+            return nullptr;
+        }
+    }
+    for (std::size_t i = 0; i < tree->childCount_; ++i) {
+        if (!refOk(tree->childKeyData_[i]) ||
+            tree->childNodeData_[i] >= tree->nodeCount_) {
+            return nullptr;
+        }
+    }
+
+    return tree;
+}
+
 CLI* CLI::instance_ = nullptr;
 
+thread_local OutputSink* CLI::threadSink_ = nullptr;
+thread_local const std::string* CLI::threadPipeInput_ = nullptr;
+const std::string CLI::emptyPipeInput_;
+
+void OutputSink::flush()
+{
+    if (buffer_.empty()) {
+        return;
+    }
+    std::size_t offset = 0;
+    while (offset < buffer_.length()) {
+        ssize_t n = ::write(fd_, buffer_.data() + offset, buffer_.length() - offset);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        offset += n;
+    }
+    buffer_.clear();
+}
+
 static void signalHandler(int signum)
 {
     (void)signum;
@@ -62,6 +270,244 @@ CLI::CLI()
 
     registerCommand("clear", "Clear the screen",
                     [this](const std::vector<std::string>& args) { cmdClear(args); });
+
+    registerCommand("jobs", "List background jobs",
+                    [this](const std::vector<std::string>& args) { cmdJobs(args); });
+
+    registerCommand("wait", "Wait for background jobs (wait [id])",
+                    [this](const std::vector<std::string>& args) { cmdWait(args); });
+
+    registerCommand("stats", "Show per-command runtime statistics",
+                    [this](const std::vector<std::string>& args) { cmdStats(args); });
+}
+
+CLI::~CLI()
+{
+    // 等待后台任务结束，避免任务线程访问已销毁的 CLI
+    for (auto& job : jobs_) {
+        if (job->thread.joinable()) {
+            job->thread.join();
+        }
+    }
+    stopWorker();
+
+    if (historyFd_ >= 0) {
+        ::close(historyFd_);
+    }
+    jobNotify_.close();
+}
+
+void CLI::setHistoryFile(std::string path, std::size_t maxEntries)
+{
+    historyPath_ = std::move(path);
+    historyMaxEntries_ = maxEntries > 0 ? maxEntries : 1;
+}
+
+/**
+ * 惰性加载持久化历史的尾部。mmap 整个文件后从末尾向前数出环内的
+ * maxEntries 行，只有尾部页面被实际读入，100k 条的旧历史和 1k 条
+ * 成本相同。发现文件过半内容落在环外时，顺手把尾部重写回文件
+ * （临时文件 + rename 原子替换），长期运行的文件体积有界。
+ */
+void CLI::loadHistoryTail()
+{
+    historyLoaded_ = true;
+    stifle_history(static_cast<int>(historyMaxEntries_));   // 内存侧的环形上界
+
+    int fd = ::open(historyPath_.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || st.st_size <= 0) {
+        ::close(fd);
+        return;
+    }
+    std::size_t size = static_cast<std::size_t>(st.st_size);
+    void* base = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED) {
+        return;
+    }
+    const char* data = static_cast<const char*>(base);
+
+    // 行区间 [begin, end)，结尾换行不算一条
+    std::size_t end = size;
+    if (data[end - 1] == '\n') {
+        --end;
+    }
+    std::size_t begin = end;
+    std::size_t remaining = historyMaxEntries_;
+    while (begin > 0 && remaining > 0) {
+        std::size_t lineStart = begin - 1;
+        while (lineStart > 0 && data[lineStart - 1] != '\n') {
+            --lineStart;
+        }
+        begin = lineStart;
+        --remaining;
+    }
+
+    // 顺序回放进 readline 历史
+    std::size_t pos = begin;
+    while (pos < end) {
+        const char* nl = static_cast<const char*>(::memchr(data + pos, '\n', end - pos));
+        std::size_t lineLen = nl ? static_cast<std::size_t>(nl - (data + pos)) : end - pos;
+        if (lineLen > 0) {
+            std::string line(data + pos, lineLen);
+            add_history(line.c_str());
+        }
+        pos += lineLen + 1;
+    }
+
+    // 环外内容（begin 之前）超过一半时压实
+    if (begin > size - begin) {
+        std::string tmpPath = historyPath_ + ".tmp";
+        int tmpFd = ::open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+        if (tmpFd >= 0) {
+            bool ok = writeAll(tmpFd, data + begin, size - begin);
+            ::close(tmpFd);
+            if (ok) {
+                ::rename(tmpPath.c_str(), historyPath_.c_str());
+            } else {
+                ::unlink(tmpPath.c_str());
+            }
+        }
+    }
+
+    ::munmap(base, size);
+}
+
+// 每条命令增量追加；fd 常开，O_APPEND 保证多进程下的记录完整性
+void CLI::appendHistoryLine(const std::string& line)
+{
+    if (historyFd_ < 0) {
+        historyFd_ = ::open(historyPath_.c_str(),
+                            O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+        if (historyFd_ < 0) {
+            return;
+        }
+    }
+    std::string record = line;
+    record += '\n';
+    std::size_t offset = 0;
+    while (offset < record.length()) {
+        ssize_t n = ::write(historyFd_, record.data() + offset, record.length() - offset);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        offset += n;
+    }
+}
+
+bool CLI::WakeupChannel::open()
+{
+#if defined(__linux__)
+    readFd = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    writeFd = readFd;
+    return readFd >= 0;
+#else
+    int fds[2];
+    if (::pipe(fds) < 0) {
+        return false;
+    }
+    for (int fd : fds) {
+        ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+        ::fcntl(fd, F_SETFL, O_NONBLOCK);
+    }
+    readFd = fds[0];
+    writeFd = fds[1];
+    return true;
+#endif
+}
+
+void CLI::WakeupChannel::close()
+{
+    if (readFd >= 0) {
+        ::close(readFd);
+    }
+    if (writeFd >= 0 && writeFd != readFd) {
+        ::close(writeFd);
+    }
+    readFd = -1;
+    writeFd = -1;
+}
+
+void CLI::WakeupChannel::signalFd(int fd)
+{
+    if (fd < 0) {
+        return;
+    }
+#if defined(__linux__)
+    std::uint64_t one = 1;
+    ssize_t ignored = ::write(fd, &one, sizeof(one));
+    (void)ignored;
+#else
+    unsigned char byte = 1;
+    ssize_t ignored = ::write(fd, &byte, sizeof(byte));
+    (void)ignored;
+#endif
+}
+
+bool CLI::WakeupChannel::drain() const
+{
+    if (readFd < 0) {
+        return false;
+    }
+#if defined(__linux__)
+    std::uint64_t counter = 0;
+    return ::read(readFd, &counter, sizeof(counter)) ==
+           static_cast<ssize_t>(sizeof(counter));
+#else
+    unsigned char buf[64];
+    bool woken = false;
+    while (::read(readFd, buf, sizeof(buf)) > 0) {
+        woken = true;
+    }
+    return woken;
+#endif
+}
+
+void CLI::ensureWorker()
+{
+    if (workerDone_.readFd < 0) {
+        workerDone_.open();
+    }
+    if (!worker_.joinable()) {
+        worker_ = std::thread([this]() { workerLoop(); });
+    }
+}
+
+void CLI::stopWorker()
+{
+    if (worker_.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(workerMutex_);
+            workerStop_ = true;
+        }
+        workerCv_.notify_one();
+        worker_.join();
+    }
+    workerDone_.close();
+}
+
+void CLI::workerLoop()
+{
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(workerMutex_);
+            workerCv_.wait(lock, [this]() { return workerStop_ || workerTask_; });
+            if (workerStop_ && !workerTask_) {
+                return;
+            }
+            task = std::move(workerTask_);
+            workerTask_ = nullptr;
+        }
+        task();
+    }
 }
 
 bool CLI::isCommandRunning()
@@ -72,18 +518,138 @@ bool CLI::isCommandRunning()
     return instance_->commandRunning_.load();
 }
 
-void CLI::registerCommand(const std::string& name,
-                         const std::string& description,
+void CLI::registerCommand(std::string name,
+                         std::string description,
                          CommandHandler handler,
                          TreeCompleter completer,
                          ParamValidator validator)
 {
-    CommandInfo info;
-    info.description = description;
-    info.handler = handler;
-    info.completer = completer;
-    info.validator = validator;
-    commands_[name] = info;
+    // 全程移动：名字、描述和回调在注册路径上各只构造一次
+    auto info = std::make_shared<CommandInfo>();
+    info->description = std::move(description);
+    info->handler = std::move(handler);
+    info->completer = std::move(completer);
+    info->validator = std::move(validator);
+    info->stats = std::make_shared<CommandStats>();
+
+    std::lock_guard<std::mutex> lock(registerMutex_);
+    staged_.emplace_back(std::move(name), std::move(info));
+    rebuildRegistryLocked();
+}
+
+void CLI::registerCommand(std::string name,
+                         std::string description,
+                         CommandHandler handler,
+                         TreeViewCompleter completer,
+                         ParamValidator validator)
+{
+    auto info = std::make_shared<CommandInfo>();
+    info->description = std::move(description);
+    info->handler = std::move(handler);
+    info->viewCompleter = std::move(completer);
+    info->validator = std::move(validator);
+    info->stats = std::make_shared<CommandStats>();
+
+    std::lock_guard<std::mutex> lock(registerMutex_);
+    staged_.emplace_back(std::move(name), std::move(info));
+    rebuildRegistryLocked();
+}
+
+void CLI::registerCommands(std::vector<CommandDef> defs)
+{
+    std::lock_guard<std::mutex> lock(registerMutex_);
+    for (auto& def : defs) {
+        auto info = std::make_shared<CommandInfo>();
+        info->description = std::move(def.description);
+        info->handler = std::move(def.handler);
+        info->completer = std::move(def.completer);
+        info->viewCompleter = std::move(def.viewCompleter);
+        info->validator = std::move(def.validator);
+        info->stats = std::make_shared<CommandStats>();
+        staged_.emplace_back(std::move(def.name), std::move(info));
+    }
+    rebuildRegistryLocked();
+}
+
+const CLI::CommandInfo* CLI::Registry::find(std::string_view name) const
+{
+    auto it = std::lower_bound(names.begin(), names.end(), name,
+                               [](const std::string& a, std::string_view b) {
+                                   return std::string_view(a) < b;
+                               });
+    if (it == names.end() || std::string_view(*it) != name) {
+        return nullptr;
+    }
+    return infos[it - names.begin()].get();
+}
+
+void CLI::rebuildRegistryLocked()
+{
+    // 稳定排序后同名保留最后一次注册，保持 map 时代的覆盖语义。
+    // staged_ 就地压实成压缩后的结果：暂存区和每次重建的成本都以
+    // 当前命令数为界，不随进程生命周期内的注册次数无界增长
+    std::vector<std::size_t> order(staged_.size());
+    for (std::size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(),
+                     [this](std::size_t a, std::size_t b) {
+                         return staged_[a].first < staged_[b].first;
+                     });
+
+    std::vector<std::pair<std::string, std::shared_ptr<const CommandInfo>>> compacted;
+    compacted.reserve(order.size());
+    for (std::size_t i = 0; i < order.size(); ++i) {
+        if (i + 1 < order.size() &&
+            staged_[order[i]].first == staged_[order[i + 1]].first) {
+            continue;
+        }
+        compacted.push_back(std::move(staged_[order[i]]));
+    }
+    staged_ = std::move(compacted);
+
+    // 快照只拷贝名字和 CommandInfo 指针；回调本体（四个 std::function
+    // 和捕获的补全状态）在所有快照间共享
+    auto frozen = std::make_shared<Registry>();
+    frozen->names.reserve(staged_.size());
+    frozen->infos.reserve(staged_.size());
+    for (const auto& entry : staged_) {
+        frozen->names.push_back(entry.first);
+        frozen->infos.push_back(entry.second);
+    }
+
+    // help 文本在写侧渲染进快照：读者拿到的注册表和 help 永远一致，
+    // 运行期重注册也不会与并发的 cmdHelp 争用一块可变缓存
+    std::string& help = frozen->helpText;
+    help += Color::CYAN;
+    help += Color::BOLD;
+    help += "\nAvailable Commands:";
+    help += Color::RESET;
+    help += "\n";
+    help += std::string(50, '-');
+    help += "\n";
+    for (std::size_t i = 0; i < frozen->names.size(); ++i) {
+        const std::string& name = frozen->names[i];
+        help += Color::YELLOW;
+        help += "  ";
+        help += name;
+        help += Color::RESET;
+
+        int padding = 15 - name.length();
+        if (padding > 0) {
+            help.append(padding, ' ');
+        }
+        else {
+            help += " ";
+        }
+
+        help += frozen->infos[i]->description;
+        help += "\n";
+    }
+    help += "\n";
+
+    // 读者继续使用旧快照直至释放；新快照原子换入，读侧始终无锁
+    std::atomic_store(&registry_, std::shared_ptr<const Registry>(std::move(frozen)));
 }
 
 void CLI::printWelcome()
@@ -106,51 +672,222 @@ void CLI::printPrompt()
 
 std::vector<std::string> CLI::parseCommandLine(const std::string& line)
 {
-    std::vector<std::string> tokens;
-    std::istringstream iss(line);
-    std::string token;
+    // 处理函数边界需要自有字符串，这里把视图 token 物化一次
+    std::string storage;
+    std::vector<std::string_view> views;
+    tokenizeLine(line, views, storage);
 
-    while (iss >> token) {
-        tokens.push_back(token);
+    std::vector<std::string> tokens;
+    tokens.reserve(views.size());
+    for (const auto& view : views) {
+        tokens.emplace_back(view);
     }
-
     return tokens;
 }
 
 bool CLI::executeCommand(const std::vector<std::string>& tokens)
+{
+    return dispatchTokens(tokens, true);
+}
+
+// 分发一组 token；monitorCtrlD 透传给前台命令执行
+// （批处理路径为 false，避免 Ctrl+D 监控读走脚本的 stdin）
+bool CLI::dispatchTokens(const std::vector<std::string>& tokens, bool monitorCtrlD)
 {
     if (tokens.empty()) {
         return true;
     }
 
-    const std::string& cmd = tokens[0];
+    // ';' 串接：切成独立片段依次执行，与逐行输入等价
+    if (std::find(tokens.begin(), tokens.end(), ";") != tokens.end()) {
+        bool ok = true;
+        std::vector<std::string> segment;
+        for (const auto& token : tokens) {
+            if (token == ";") {
+                if (!segment.empty()) {
+                    ok = dispatchTokens(segment, monitorCtrlD) && ok;
+                    segment.clear();
+                }
+                continue;
+            }
+            segment.push_back(token);
+        }
+        if (!segment.empty()) {
+            ok = dispatchTokens(segment, monitorCtrlD) && ok;
+        }
+        return ok;
+    }
 
-    auto it = commands_.find(cmd);
-    if (it != commands_.end()) {
-        return invokeCommand(it->second, tokens, true);
+    // '|' 管道：阶段间缓冲移动交接（见 executePipeline）
+    if (std::find(tokens.begin(), tokens.end(), "|") != tokens.end()) {
+        std::vector<std::vector<std::string>> stages(1);
+        for (const auto& token : tokens) {
+            if (token == "|") {
+                stages.emplace_back();
+            } else {
+                stages.back().push_back(token);
+            }
+        }
+        return executePipeline(stages);
     }
 
-    std::cout << Color::RED << "Unknown command: " << cmd
-              << ". Type 'help' for available commands."
-              << Color::RESET << std::endl;
+    // 尾随 "&"：转入后台执行，立即返回提示符
+    if (tokens.size() > 1 && tokens.back() == "&") {
+        std::vector<std::string> jobTokens(tokens.begin(), tokens.end() - 1);
+        return submitAsync(jobTokens) >= 0;
+    }
+
+    const std::string& cmd = tokens[0];
+    CARLINK_PROBE1(dispatch_entry, cmd.c_str());
+
+    // 持有快照，命令执行期间的注册不会使 info 失效
+    auto reg = registry();
+    const CommandInfo* info = reg->find(cmd);
+    if (info) {
+        bool handled = invokeCommand(*info, tokens, monitorCtrlD);
+        CARLINK_PROBE2(dispatch_exit, cmd.c_str(), handled);
+        return handled;
+    }
+    CARLINK_PROBE2(dispatch_exit, cmd.c_str(), false);
+
+    sink_.write(Color::RED);
+    sink_.write("Unknown command: ");
+    sink_.write(cmd);
+    sink_.write(". Type 'help' for available commands.");
+    sink_.write(Color::RESET);
+    sink_.write("\n");
+    sink_.flush();
     return false;
 }
 
+/**
+ * 管道执行：上游处理函数照常经 out() 写缓冲，阶段结束时整块缓冲
+ * 移动交接（takeBuffer）给下游的 in() —— 不经过进程、文件或拷贝。
+ * 末级阶段写回外层输出（交互的 sink_ / 会话或批处理的线程本地缓冲）。
+ * 任一阶段命令未知则整条管道不执行；验证失败或异常终止后续阶段。
+ */
+bool CLI::executePipeline(const std::vector<std::vector<std::string>>& stages)
+{
+    auto reg = registry();
+    OutputSink* outerSink = threadSink_;
+    const std::string* outerInput = threadPipeInput_;
+
+    // 预检所有阶段，避免执行半条管道后才发现下游不存在
+    for (const auto& stage : stages) {
+        if (stage.empty()) {
+            out().write(Color::RED);
+            out().write("Invalid pipeline: empty stage");
+            out().write(Color::RESET);
+            out().write("\n");
+            out().flush();
+            return false;
+        }
+        if (!reg->find(stage[0])) {
+            out().write(Color::RED);
+            out().write("Unknown command: ");
+            out().write(stage[0]);
+            out().write(". Type 'help' for available commands.");
+            out().write(Color::RESET);
+            out().write("\n");
+            out().flush();
+            return false;
+        }
+    }
+
+    std::string carried;    // 上游输出，阶段间移动交接
+    OutputSink capture;     // 中间阶段的输出只进缓冲，从不落 fd
+
+    for (std::size_t s = 0; s < stages.size(); ++s) {
+        const CommandInfo* info = reg->find(stages[s][0]);
+        bool lastStage = (s + 1 == stages.size());
+
+        threadPipeInput_ = (s == 0) ? outerInput : &carried;
+        threadSink_ = lastStage ? outerSink : &capture;
+
+        try {
+            std::string error;
+            if (info->validator) {
+                error = info->validator(stages[s]);
+            }
+            if (!error.empty()) {
+                threadSink_ = outerSink;
+                threadPipeInput_ = outerInput;
+                out().write(Color::RED);
+                out().write(error);
+                out().write(Color::RESET);
+                out().write("\n");
+                out().flush();
+                return true;
+            }
+            info->handler(stages[s]);
+        }
+        catch (const std::exception& e) {
+            threadSink_ = outerSink;
+            threadPipeInput_ = outerInput;
+            out().write(Color::RED);
+            out().write("Error: ");
+            out().write(e.what());
+            out().write(Color::RESET);
+            out().write("\n");
+            out().flush();
+            return true;
+        }
+
+        if (!lastStage) {
+            carried = capture.takeBuffer();
+        }
+    }
+
+    threadSink_ = outerSink;
+    threadPipeInput_ = outerInput;
+    out().flush();
+    return true;
+}
+
 bool CLI::invokeCommand(const CommandInfo& info,
                         const std::vector<std::string>& tokens,
                         bool monitorCtrlD)
 {
+    using StatsClock = std::chrono::steady_clock;
+    auto elapsedUs = [](StatsClock::time_point since) {
+        return static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(StatsClock::now() - since).count());
+    };
+    CommandStats* stats = info.stats.get();
+    if (stats) {
+        stats->invocations.fetch_add(1, std::memory_order_relaxed);
+    }
+
     try {
         if (info.validator) {
+            CARLINK_PROBE1(validate_entry, tokens[0].c_str());
+            auto validateStart = StatsClock::now();
             std::string error = info.validator(tokens);
+            if (stats) {
+                stats->validatorUs.record(elapsedUs(validateStart));
+            }
+            CARLINK_PROBE2(validate_exit, tokens[0].c_str(), error.empty());
             if (!error.empty()) {
-                std::cout << Color::RED << error << Color::RESET << std::endl;
+                sink_.write(Color::RED);
+                sink_.write(error);
+                sink_.write(Color::RESET);
+                sink_.write("\n");
+                sink_.flush();
                 return true;
             }
         }
 
         if (!monitorCtrlD) {
+            auto handlerStart = StatsClock::now();
             info.handler(tokens);
+            if (stats) {
+                stats->handlerUs.record(elapsedUs(handlerStart));
+            }
+            auto flushStart = StatsClock::now();
+            sink_.flush();   // 命令结束一次性刷出缓冲的输出
+            if (stats) {
+                stats->flushUs.record(elapsedUs(flushStart));
+            }
             return true;
         }
 
@@ -158,31 +895,59 @@ bool CLI::invokeCommand(const CommandInfo& info,
         std::atomic<bool> finished{false};
         commandRunning_.store(true);
 
-        std::thread worker([&]() {
-            try {
-                info.handler(tokens);
-            }
-            catch (...) {
-                workerException = std::current_exception();
-            }
-            finished.store(true);
-        });
+        // 提交到常驻工作线程；单槽位交接，命令在途时不会有第二次提交
+        ensureWorker();
+        {
+            std::lock_guard<std::mutex> lock(workerMutex_);
+            workerTask_ = [&, doneFd = workerDone_.writeFd]() {
+                try {
+                    auto handlerStart = StatsClock::now();
+                    info.handler(tokens);
+                    if (stats) {
+                        stats->handlerUs.record(elapsedUs(handlerStart));
+                    }
+                }
+                catch (...) {
+                    workerException = std::current_exception();
+                }
+                finished.store(true);
+                // 唤醒监控循环；完成信号经唤醒通道送达，循环无需超时轮询
+                WakeupChannel::signalFd(doneFd);
+            };
+        }
+        workerCv_.notify_one();
+        CARLINK_PROBE1(worker_handoff, tokens[0].c_str());
 
         while (!finished.load()) {
-            struct pollfd pfd;
-            pfd.fd = STDIN_FILENO;
-            pfd.events = POLLIN | POLLHUP | POLLERR;
-            pfd.revents = 0;
-
-            int ret = poll(&pfd, 1, 100);
+            struct pollfd pfds[2];
+            pfds[0].fd = STDIN_FILENO;
+            pfds[0].events = POLLIN | POLLHUP | POLLERR;
+            pfds[0].revents = 0;
+            pfds[1].fd = workerDone_.readFd;
+            pfds[1].events = POLLIN;
+            pfds[1].revents = 0;
+
+            // 唤醒通道可用时无限阻塞，精确在命令完成或有输入时唤醒；
+            // 创建失败则退回 100ms 超时轮询
+            int timeout = (workerDone_.readFd >= 0) ? -1 : 100;
+            nfds_t nfds = (workerDone_.readFd >= 0) ? 2 : 1;
+
+            int ret = poll(pfds, nfds, timeout);
             if (ret <= 0) {
                 continue;
             }
 
+            if (nfds > 1 && (pfds[1].revents & POLLIN)) {
+                workerDone_.drain();
+                continue;   // 重新检查 finished
+            }
+
+            struct pollfd& pfd = pfds[0];
             if (pfd.revents & (POLLIN | POLLHUP)) {
                 char buffer[64] = {0};
                 ssize_t n = read(STDIN_FILENO, buffer, sizeof(buffer));
                 if (n == 0) {
+                    sink_.flush();   // 不丢弃命令已产生的输出
                     std::cout << Color::CYAN << "\nGoodbye!" << Color::RESET << std::endl;
                     std::cout.flush();
                     std::_Exit(0);
@@ -190,6 +955,7 @@ bool CLI::invokeCommand(const CommandInfo& info,
 
                 for (ssize_t i = 0; i < n; ++i) {
                     if (buffer[i] == 0x04) {
+                        sink_.flush();
                         std::cout << Color::CYAN << "\nGoodbye!" << Color::RESET << std::endl;
                         std::cout.flush();
                         std::_Exit(0);
@@ -198,8 +964,13 @@ bool CLI::invokeCommand(const CommandInfo& info,
             }
         }
 
-        worker.join();
         commandRunning_.store(false);
+        CARLINK_PROBE1(worker_done, tokens[0].c_str());
+        auto flushStart = StatsClock::now();
+        sink_.flush();   // 命令结束一次性刷出缓冲的输出
+        if (stats) {
+            stats->flushUs.record(elapsedUs(flushStart));
+        }
 
         if (workerException) {
             std::rethrow_exception(workerException);
@@ -207,8 +978,12 @@ bool CLI::invokeCommand(const CommandInfo& info,
     }
     catch (const std::exception& e) {
         commandRunning_.store(false);
-        std::cout << Color::RED << "Error: " << e.what()
-                  << Color::RESET << std::endl;
+        sink_.write(Color::RED);
+        sink_.write("Error: ");
+        sink_.write(e.what());
+        sink_.write(Color::RESET);
+        sink_.write("\n");
+        sink_.flush();
     }
 
     return true;
@@ -218,53 +993,318 @@ void CLI::cmdHelp(const std::vector<std::string>& args)
 {
     (void)args;
 
-    std::cout << Color::CYAN << Color::BOLD
-              << "\nAvailable Commands:"
-              << Color::RESET << std::endl;
-    std::cout << std::string(50, '-') << std::endl;
+    // help 文本随注册表快照预渲染，稳态下每次调用只是一次整块写出。
+    // 经 out() 走线程本地路由：服务端会话/并行批处理/管道各自拿到
+    // 自己的缓冲，而不是落进交互 sink_
+    out().write(registry()->helpText);
+}
 
-    std::vector<std::pair<std::string, CommandInfo>> sorted_commands(
-        commands_.begin(), commands_.end());
-    std::sort(sorted_commands.begin(), sorted_commands.end(),
-              [](const auto& a, const auto& b) { return a.first < b.first; });
+void CLI::cmdExit(const std::vector<std::string>& args)
+{
+    (void)args;
 
-    for (const auto& [name, info] : sorted_commands) {
-        std::cout << Color::YELLOW << "  " << name << Color::RESET;
+    std::cout << Color::CYAN << "Goodbye!" << Color::RESET << std::endl;
+    running_ = false;
+}
 
-        int padding = 15 - name.length();
-        if (padding > 0) {
-            std::cout << std::string(padding, ' ');
+void CLI::cmdClear(const std::vector<std::string>& args)
+{
+    (void)args;
+
+    // 清屏：ANSI 转义序列
+    std::cout << "\033[2J\033[H";
+    std::cout.flush();
+}
+
+int CLI::submitAsync(const std::vector<std::string>& args)
+{
+    if (args.empty()) {
+        return -1;
+    }
+
+    auto reg = registry();
+    const CommandInfo* info = reg->find(args[0]);
+    if (!info) {
+        sink_.write(Color::RED);
+        sink_.write("Unknown command: ");
+        sink_.write(args[0]);
+        sink_.write(Color::RESET);
+        sink_.write("\n");
+        sink_.flush();
+        return -1;
+    }
+
+    std::lock_guard<std::mutex> lock(jobsMutex_);
+
+    auto job = std::make_unique<Job>();
+    job->id = nextJobId_++;
+    for (const auto& arg : args) {
+        if (!job->command.empty()) job->command += " ";
+        job->command += arg;
+    }
+    Job* raw = job.get();
+
+    sink_.write(Color::CYAN);
+    sink_.write("[" + std::to_string(raw->id) + "] started: " + raw->command);
+    sink_.write(Color::RESET);
+    sink_.write("\n");
+    sink_.flush();
+
+    // 每个后台任务一个线程；输出经线程本地路由进任务自己的缓冲
+    job->thread = std::thread([this, raw, info, reg, args]() {
+        threadSink_ = &raw->sink;
+        try {
+            bool proceed = true;
+            if (info->validator) {
+                std::string error = info->validator(args);
+                if (!error.empty()) {
+                    raw->sink.write(Color::RED);
+                    raw->sink.write(error);
+                    raw->sink.write(Color::RESET);
+                    raw->sink.write("\n");
+                    proceed = false;
+                }
+            }
+            if (proceed) {
+                info->handler(args);
+            }
         }
-        else {
-            std::cout << " ";
+        catch (const std::exception& e) {
+            raw->sink.write(Color::RED);
+            raw->sink.write("Error: ");
+            raw->sink.write(e.what());
+            raw->sink.write(Color::RESET);
+            raw->sink.write("\n");
         }
+        threadSink_ = nullptr;
+        raw->finished.store(true);
+        onJobFinished(*raw);
+    });
+
+    jobs_.push_back(std::move(job));
+    return raw->id;
+}
+
+void CLI::printJobNotification(Job& job)
+{
+    std::cout << Color::CYAN << "[" << job.id << "] done: " << job.command
+              << Color::RESET << std::endl;
+    job.sink.flush();
+    job.notified = true;
+}
+
+void CLI::onJobFinished(Job& job)
+{
+    (void)job;
+    // readline 不是线程安全的，任务线程绝不直接重绘：只往唤醒通道
+    // 递增一次，提示符空闲时由 readline 的事件回调（jobEventHook）
+    // 在主线程消费并打印。前台命令占着终端时回调不会运行，通知由
+    // 下一个提示符前的 reapJobs 补发，此时多出的唤醒是无害的空转
+    jobNotify_.signal();
+}
+
+int CLI::jobEventHook()
+{
+    CLI* cli = instance_;
+    if (!cli) {
+        return 0;
+    }
 
-        std::cout << info.description << std::endl;
+    // 非阻塞读：无事件时 EAGAIN，回调按 readline 的输入超时周期空转
+    if (!cli->jobNotify_.drain()) {
+        return 0;
     }
 
-    std::cout << std::endl;
+    std::lock_guard<std::mutex> lock(cli->jobsMutex_);
+    bool printed = false;
+    for (auto& job : cli->jobs_) {
+        if (job->finished.load() && !job->notified) {
+            if (!printed) {
+                // 清掉当前输入行，在提示符上方打印通知
+                std::cout << "\r\033[K";
+                printed = true;
+            }
+            cli->printJobNotification(*job);
+        }
+    }
+    if (printed) {
+        rl_on_new_line();
+        rl_forced_update_display();
+    }
+    return 0;
 }
 
-void CLI::cmdExit(const std::vector<std::string>& args)
+void CLI::reapJobs()
+{
+    std::lock_guard<std::mutex> lock(jobsMutex_);
+    for (auto it = jobs_.begin(); it != jobs_.end();) {
+        Job& job = **it;
+        if (job.finished.load()) {
+            if (!job.notified) {
+                printJobNotification(job);
+            }
+            if (job.thread.joinable()) {
+                job.thread.join();
+            }
+            it = jobs_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void CLI::cmdJobs(const std::vector<std::string>& args)
 {
     (void)args;
 
-    std::cout << Color::CYAN << "Goodbye!" << Color::RESET << std::endl;
-    running_ = false;
+    std::lock_guard<std::mutex> lock(jobsMutex_);
+    if (jobs_.empty()) {
+        out().writeLine("No background jobs");
+        return;
+    }
+    for (const auto& job : jobs_) {
+        out().write("[" + std::to_string(job->id) + "] ");
+        out().write(job->finished.load() ? "done    " : "running ");
+        out().writeLine(job->command);
+    }
 }
 
-void CLI::cmdClear(const std::vector<std::string>& args)
+void CLI::cmdWait(const std::vector<std::string>& args)
+{
+    int targetId = -1;
+    if (args.size() > 1) {
+        targetId = atoi(args[1].c_str());
+    }
+
+    // 在锁外 join，任务完成回调需要拿 jobsMutex_
+    for (;;) {
+        Job* target = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(jobsMutex_);
+            for (auto& job : jobs_) {
+                if (targetId >= 0 && job->id != targetId) {
+                    continue;
+                }
+                if (job->thread.joinable()) {
+                    target = job.get();
+                    break;
+                }
+            }
+        }
+        if (!target) {
+            break;
+        }
+        target->thread.join();
+    }
+
+    // 统一补发通知并回收
+    std::lock_guard<std::mutex> lock(jobsMutex_);
+    for (auto it = jobs_.begin(); it != jobs_.end();) {
+        Job& job = **it;
+        if ((targetId < 0 || job.id == targetId) && job.finished.load()) {
+            if (!job.notified) {
+                out().write(Color::CYAN);
+                out().write("[" + std::to_string(job.id) + "] done: " + job.command);
+                out().write(Color::RESET);
+                out().write("\n");
+                out().flush();   // 先刷通知行，保证在任务输出之前
+                job.sink.flush();
+                job.notified = true;
+            }
+            it = jobs_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+// stats 命令：逐命令输出机器可读的调用计数和三段延迟直方图
+void CLI::cmdStats(const std::vector<std::string>& args)
 {
     (void)args;
 
-    // 清屏：ANSI 转义序列
-    std::cout << "\033[2J\033[H";
-    std::cout.flush();
+    auto writeHistogram = [this](const char* phase, const LatencyHistogram& hist) {
+        out().write(" ");
+        out().write(phase);
+        out().write("_total_us=");
+        out().write(std::to_string(hist.totalUs.load(std::memory_order_relaxed)));
+        out().write(" ");
+        out().write(phase);
+        out().write("_hist=");
+        bool empty = true;
+        for (std::size_t i = 0; i < LatencyHistogram::BUCKET_COUNT; ++i) {
+            std::uint64_t count = hist.buckets[i].load(std::memory_order_relaxed);
+            if (count == 0) {
+                continue;
+            }
+            if (!empty) {
+                out().write(",");
+            }
+            out().write(std::to_string(i));
+            out().write(":");
+            out().write(std::to_string(count));
+            empty = false;
+        }
+        if (empty) {
+            out().write("-");
+        }
+    };
+
+    out().writeLine("# per-command stats; hist bucket i covers [2^i, 2^(i+1)) us");
+    auto reg = registry();
+    for (std::size_t i = 0; i < reg->names.size(); ++i) {
+        const CommandInfo& info = *reg->infos[i];
+        if (!info.stats) {
+            continue;
+        }
+        out().write("command=");
+        out().write(reg->names[i]);
+        out().write(" calls=");
+        out().write(std::to_string(info.stats->invocations.load(std::memory_order_relaxed)));
+        writeHistogram("validator", info.stats->validatorUs);
+        writeHistogram("handler", info.stats->handlerUs);
+        writeHistogram("flush", info.stats->flushUs);
+        out().write("\n");
+    }
+}
+
+// 解析 --server / --client 形式的选项，支持 --flag 和 --flag=path 两种写法
+static bool parseModeFlag(const std::string& arg, const char* flag, std::string& path)
+{
+    if (arg == flag) {
+        path = CLI::DEFAULT_SOCKET_PATH;
+        return true;
+    }
+    std::string prefix = std::string(flag) + "=";
+    if (arg.compare(0, prefix.length(), prefix) == 0) {
+        path = arg.substr(prefix.length());
+        return true;
+    }
+    return false;
 }
 
 int CLI::run(int argc, char** argv)
 {
     if (argc > 1) {
+        std::string socketPath;
+        if (strcmp(argv[1], "--batch") == 0) {
+            return runBatch();
+        }
+        if (strncmp(argv[1], "--batch=", 8) == 0) {
+            int workers = atoi(argv[1] + 8);
+            return runBatch(workers > 1 ? (unsigned)workers : 1);
+        }
+        if (parseModeFlag(argv[1], "--server", socketPath)) {
+            return runServer(socketPath);
+        }
+        if (parseModeFlag(argv[1], "--client", socketPath)) {
+            std::vector<std::string> args;
+            for (int i = 2; i < argc; ++i) {
+                args.push_back(argv[i]);
+            }
+            return runClient(socketPath, args);
+        }
+
         std::vector<std::string> args;
         for (int i = 1; i < argc; ++i) {
             args.push_back(argv[i]);
@@ -273,17 +1313,283 @@ int CLI::run(int argc, char** argv)
         return 0;
     }
 
+    // stdin 不是终端（CI 管道 / 重定向的脚本）时走批处理路径，
+    // 避免 50k 行脚本逐行付出 readline 和历史记录的开销
+    if (!isatty(STDIN_FILENO)) {
+        return runBatch();
+    }
+
     printWelcome();
     runInteractiveShell();
     return 0;
 }
 
+int CLI::runBatch(unsigned workers)
+{
+    std::string carry;                   // 跨读取块的半行
+    std::vector<char> buffer(64 * 1024);
+    std::string errors;                  // 未知命令按行号汇总，最后一次写给 stderr
+    std::size_t lineNo = 0;
+
+    // 分词/物化缓冲在整个批处理过程中复用
+    std::vector<std::string_view> views;
+    std::string storage;
+    std::vector<std::string> args;
+
+    // ===== 并行调度（workers > 1）=====
+    // 脚本行分发到线程池并发执行；每个任务持有自己的 OutputSink 和
+    // 注册表快照，输出由主线程按提交顺序回放，结果与串行执行一致。
+    struct BatchTask {
+        std::vector<std::string> args;
+        const CommandInfo* info = nullptr;
+        std::shared_ptr<const Registry> reg;   // 保证 info 在执行期间有效
+        OutputSink sink;
+        std::promise<void> done;
+        std::future<void> doneFuture;
+    };
+    std::deque<BatchTask*> workQueue;
+    std::mutex queueMutex;
+    std::condition_variable queueCv;
+    bool poolStop = false;
+    std::vector<std::thread> pool;
+    std::deque<std::unique_ptr<BatchTask>> inFlight;   // 提交顺序，用于按序回放
+    // 在途任务上限：超过后提交侧阻塞等队首完成，内存以该常数为界，
+    // 不随脚本长度增长（队首一条慢命令挡住回放时尤其重要）
+    constexpr std::size_t MAX_IN_FLIGHT = 256;
+
+    auto runTask = [](BatchTask& task) {
+        threadSink_ = &task.sink;
+        try {
+            bool proceed = true;
+            if (task.info->validator) {
+                std::string error = task.info->validator(task.args);
+                if (!error.empty()) {
+                    task.sink.write(Color::RED);
+                    task.sink.write(error);
+                    task.sink.write(Color::RESET);
+                    task.sink.write("\n");
+                    proceed = false;
+                }
+            }
+            if (proceed) {
+                task.info->handler(task.args);
+            }
+        }
+        catch (const std::exception& e) {
+            task.sink.write(Color::RED);
+            task.sink.write("Error: ");
+            task.sink.write(e.what());
+            task.sink.write(Color::RESET);
+            task.sink.write("\n");
+        }
+        threadSink_ = nullptr;
+    };
+
+    if (workers > 1) {
+        pool.reserve(workers);
+        for (unsigned i = 0; i < workers; ++i) {
+            pool.emplace_back([&]() {
+                for (;;) {
+                    BatchTask* task = nullptr;
+                    {
+                        std::unique_lock<std::mutex> lock(queueMutex);
+                        queueCv.wait(lock, [&]() { return poolStop || !workQueue.empty(); });
+                        if (workQueue.empty()) {
+                            return;
+                        }
+                        task = workQueue.front();
+                        workQueue.pop_front();
+                    }
+                    runTask(*task);
+                    task->done.set_value();
+                }
+            });
+        }
+    }
+
+    // 按提交顺序回放队首已完成任务的输出；waitAll 时清空在途任务
+    auto drain = [&](bool waitAll) {
+        while (!inFlight.empty()) {
+            auto& front = inFlight.front();
+            if (waitAll) {
+                front->doneFuture.wait();
+            } else if (front->doneFuture.wait_for(std::chrono::seconds(0)) !=
+                       std::future_status::ready) {
+                break;
+            }
+            front->sink.flush();
+            inFlight.pop_front();
+        }
+    };
+
+    auto executeLine = [&](std::string_view line) {
+        ++lineNo;
+        tokenizeLine(line, views, storage);
+        if (views.empty()) {
+            return;
+        }
+
+        // 排序栅栏：等待之前提交的所有命令完成（串行模式下天然满足）
+        if (views.size() == 1 && views[0] == "%barrier") {
+            if (workers > 1) {
+                drain(true);
+            }
+            return;
+        }
+
+        args.clear();
+        args.reserve(views.size());
+        for (const auto& view : views) {
+            args.emplace_back(view);
+        }
+
+        // ';' 串接与 '|' 管道：交接依赖执行线程的本地状态，
+        // 并行模式下先清空在途任务再在主线程串行执行
+        bool chained = std::find(views.begin(), views.end(), ";") != views.end() ||
+                       std::find(views.begin(), views.end(), "|") != views.end();
+        if (chained) {
+            if (workers > 1) {
+                drain(true);
+            }
+            if (!dispatchTokens(args, false)) {
+                errors += "line " + std::to_string(lineNo) +
+                          ": Unknown command in pipeline\n";
+            }
+            return;
+        }
+
+        auto reg = registry();
+        const CommandInfo* info = reg->find(args[0]);
+        if (!info) {
+            errors += "line " + std::to_string(lineNo) +
+                      ": Unknown command: " + args[0] + "\n";
+            return;
+        }
+
+        if (workers <= 1) {
+            invokeCommand(*info, args, false);
+            return;
+        }
+
+        // exit/quit 改变 shell 状态，隐含栅栏并在主线程串行执行
+        if (args[0] == "exit" || args[0] == "quit") {
+            drain(true);
+            invokeCommand(*info, args, false);
+            return;
+        }
+
+        // 背压：主线程读脚本远快于命令执行，提交前先把在途任务压回
+        // 上限以内，而不是无界堆积任务和它们捕获的输出
+        while (inFlight.size() >= MAX_IN_FLIGHT) {
+            inFlight.front()->doneFuture.wait();
+            drain(false);
+        }
+
+        auto task = std::make_unique<BatchTask>();
+        task->args = std::move(args);
+        task->info = info;
+        task->reg = std::move(reg);
+        task->doneFuture = task->done.get_future();
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            workQueue.push_back(task.get());
+        }
+        queueCv.notify_one();
+        inFlight.push_back(std::move(task));
+
+        drain(false);   // 顺带回放已完成的队首输出，限制在途内存
+    };
+
+    while (running_) {
+        ssize_t n = ::read(STDIN_FILENO, buffer.data(), buffer.size());
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (n == 0) {
+            break;
+        }
+
+        // 原地切行：只有跨块的半行才进 carry
+        const char* data = buffer.data();
+        std::size_t len = (std::size_t)n;
+        std::size_t pos = 0;
+        while (pos < len && running_) {
+            const char* nl = (const char*)memchr(data + pos, '\n', len - pos);
+            if (!nl) {
+                carry.append(data + pos, len - pos);
+                break;
+            }
+            std::size_t lineLen = (std::size_t)(nl - (data + pos));
+            if (carry.empty()) {
+                executeLine(std::string_view(data + pos, lineLen));
+            } else {
+                carry.append(data + pos, lineLen);
+                executeLine(carry);
+                carry.clear();
+            }
+            pos = (std::size_t)(nl - data) + 1;
+        }
+    }
+
+    if (running_ && !carry.empty()) {
+        executeLine(carry);
+    }
+
+    // 收尾：回放剩余输出并停掉线程池
+    if (workers > 1) {
+        drain(true);
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            poolStop = true;
+        }
+        queueCv.notify_all();
+        for (auto& thread : pool) {
+            thread.join();
+        }
+    }
+
+    if (!errors.empty()) {
+        std::size_t offset = 0;
+        while (offset < errors.length()) {
+            ssize_t n = ::write(STDERR_FILENO, errors.data() + offset,
+                                errors.length() - offset);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                break;
+            }
+            offset += n;
+        }
+        return 1;
+    }
+    return 0;
+}
+
 void CLI::runInteractiveShell()
 {
     // 设置 readline 自动补全
     rl_attempted_completion_function = commandCompletion;
 
+    // 后台任务完成通知经唤醒通道送达主线程，readline 等待输入时
+    // 周期性调用 jobEventHook 消费并重绘（见 onJobFinished）
+    if (jobNotify_.readFd < 0) {
+        jobNotify_.open();
+    }
+    rl_event_hook = jobEventHook;
+
+    // 持久化历史只在交互会话按需加载；批处理/服务端路径从不触碰文件
+    if (!historyPath_.empty() && !historyLoaded_) {
+        loadHistoryTail();
+    }
+
     while (running_) {
+        // 补发前台命令执行期间完成的后台任务通知
+        reapJobs();
+
         char* input = readline("carlink> ");
 
         if (!input) {
@@ -300,8 +1606,11 @@ void CLI::runInteractiveShell()
             continue;
         }
 
-        // 添加到历史记录
+        // 添加到历史记录（内存侧有 stifle_history 的环形上界）
         add_history(line.c_str());
+        if (!historyPath_.empty()) {
+            appendHistoryLine(line);
+        }
 
         // 解析并执行命令
         auto tokens = parseCommandLine(line);
@@ -316,24 +1625,252 @@ void CLI::runSingleCommand(const std::vector<std::string>& args)
     }
 
     const std::string& cmd = args[0];
-    auto it = commands_.find(cmd);
-    if (it != commands_.end()) {
-        invokeCommand(it->second, args, false);
+    auto reg = registry();
+    const CommandInfo* info = reg->find(cmd);
+    if (info) {
+        invokeCommand(*info, args, false);
         return;
     }
 
-    std::cout << Color::RED << "Unknown command: " << cmd
-              << ". Type 'help' for available commands."
-              << Color::RESET << std::endl;
+    sink_.write(Color::RED);
+    sink_.write("Unknown command: ");
+    sink_.write(cmd);
+    sink_.write(". Type 'help' for available commands.");
+    sink_.write(Color::RESET);
+    sink_.write("\n");
+    sink_.flush();
 }
 
-std::vector<std::string> CLI::getCommandList() const
+int CLI::runServer(const std::string& socketPath, unsigned workers)
 {
-    std::vector<std::string> commands;
-    for (const auto& [name, _] : commands_) {
-        commands.push_back(name);
+    ::unlink(socketPath.c_str());
+
+    int listenFd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenFd < 0) {
+        std::cerr << Color::RED << "Failed to create socket: "
+                  << strerror(errno) << Color::RESET << std::endl;
+        return 1;
+    }
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+
+    if (::bind(listenFd, (struct sockaddr*)&addr, sizeof(addr)) < 0 ||
+        ::listen(listenFd, 16) < 0) {
+        std::cerr << Color::RED << "Failed to bind/listen on " << socketPath
+                  << ": " << strerror(errno) << Color::RESET << std::endl;
+        ::close(listenFd);
+        return 1;
+    }
+
+    if (workers < 1) {
+        workers = 1;
     }
-    return commands;
+
+    // 会话工作池：accept 只负责排队连接，池内线程完整处理一个会话。
+    // 注册表快照和冻结树都是只读共享结构，会话之间没有可变共享状态，
+    // 因此并发会话的增量成本只有连接缓冲本身。
+    std::deque<int> pendingConns;
+    std::mutex queueMutex;
+    std::condition_variable queueCv;
+    bool stopping = false;
+
+    // 完整处理一个会话：收 argv、执行、输出写回连接。
+    // 输出经线程本地路由落到会话自己的 OutputSink（fd 即连接），
+    // 与并行批处理同一套约定：处理函数须通过 out() 写输出。
+    auto serveSession = [this](int conn) {
+        // 协议：客户端发送以 '\0' 分隔的 argv，然后半关闭写端
+        std::string payload;
+        char buffer[4096];
+        for (;;) {
+            ssize_t n = ::read(conn, buffer, sizeof(buffer));
+            if (n > 0) {
+                payload.append(buffer, n);
+                continue;
+            }
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+
+        std::vector<std::string> args;
+        size_t pos = 0;
+        while (pos < payload.length()) {
+            size_t end = payload.find('\0', pos);
+            if (end == std::string::npos) {
+                end = payload.length();
+            }
+            args.push_back(payload.substr(pos, end - pos));
+            pos = end + 1;
+        }
+
+        OutputSink sessionSink;
+        sessionSink.setFd(conn);
+        threadSink_ = &sessionSink;
+
+        auto reg = registry();
+        const CommandInfo* info = args.empty() ? nullptr : reg->find(args[0]);
+        if (!info) {
+            if (!args.empty()) {
+                sessionSink.write(Color::RED);
+                sessionSink.write("Unknown command: ");
+                sessionSink.write(args[0]);
+                sessionSink.write(". Type 'help' for available commands.");
+                sessionSink.write(Color::RESET);
+                sessionSink.write("\n");
+            }
+        } else {
+            try {
+                std::string error;
+                if (info->validator) {
+                    error = info->validator(args);
+                }
+                if (!error.empty()) {
+                    sessionSink.write(Color::RED);
+                    sessionSink.write(error);
+                    sessionSink.write(Color::RESET);
+                    sessionSink.write("\n");
+                } else {
+                    info->handler(args);
+                }
+            }
+            catch (const std::exception& e) {
+                sessionSink.write(Color::RED);
+                sessionSink.write("Error: ");
+                sessionSink.write(e.what());
+                sessionSink.write(Color::RESET);
+                sessionSink.write("\n");
+            }
+        }
+
+        sessionSink.flush();
+        threadSink_ = nullptr;
+        ::close(conn);
+    };
+
+    std::vector<std::thread> pool;
+    pool.reserve(workers);
+    for (unsigned i = 0; i < workers; ++i) {
+        pool.emplace_back([&]() {
+            for (;;) {
+                int conn = -1;
+                {
+                    std::unique_lock<std::mutex> lock(queueMutex);
+                    queueCv.wait(lock, [&]() { return stopping || !pendingConns.empty(); });
+                    if (pendingConns.empty()) {
+                        return;
+                    }
+                    conn = pendingConns.front();
+                    pendingConns.pop_front();
+                }
+                serveSession(conn);
+            }
+        });
+    }
+
+    while (running_) {
+        int conn = ::accept(listenFd, nullptr, nullptr);
+        if (conn < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            pendingConns.push_back(conn);
+        }
+        queueCv.notify_one();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        stopping = true;
+    }
+    queueCv.notify_all();
+    for (auto& thread : pool) {
+        thread.join();
+    }
+    for (int conn : pendingConns) {
+        ::close(conn);
+    }
+
+    ::close(listenFd);
+    ::unlink(socketPath.c_str());
+    return 0;
+}
+
+int CLI::runClient(const std::string& socketPath,
+                   const std::vector<std::string>& args)
+{
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        std::cerr << Color::RED << "Failed to create socket: "
+                  << strerror(errno) << Color::RESET << std::endl;
+        return 1;
+    }
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+
+    if (::connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        std::cerr << Color::RED << "Failed to connect to " << socketPath
+                  << ": " << strerror(errno) << Color::RESET << std::endl;
+        ::close(fd);
+        return 1;
+    }
+
+    std::string payload;
+    for (const auto& arg : args) {
+        payload += arg;
+        payload += '\0';
+    }
+
+    size_t written = 0;
+    while (written < payload.length()) {
+        ssize_t n = ::write(fd, payload.data() + written, payload.length() - written);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ::close(fd);
+            return 1;
+        }
+        written += n;
+    }
+    ::shutdown(fd, SHUT_WR);
+
+    // 把服务端的响应原样转发到 stdout
+    char buffer[4096];
+    ssize_t n;
+    while ((n = ::read(fd, buffer, sizeof(buffer))) > 0) {
+        ssize_t off = 0;
+        while (off < n) {
+            ssize_t w = ::write(STDOUT_FILENO, buffer + off, n - off);
+            if (w < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                ::close(fd);
+                return 1;
+            }
+            off += w;
+        }
+    }
+
+    ::close(fd);
+    return 0;
+}
+
+std::vector<std::string> CLI::getCommandList()
+{
+    // 注册表名字数组即为有序命令列表
+    return registry()->names;
 }
 
 char** CLI::commandCompletion(const char* text, int start, int end)
@@ -352,22 +1889,24 @@ char** CLI::commandCompletion(const char* text, int start, int end)
         return rl_completion_matches(text, commandGenerator);
     }
     
-    // 否则尝试补全参数
+    // 否则尝试补全参数（复用成员缓冲分词，稳态零分配）
     size_t max_pos = std::min((size_t)(start + strlen(text)), line.length());
-    auto tokens = instance_->parseCommandLine(line.substr(0, max_pos));
-    
+    auto& tokens = instance_->completionTokens_;
+    tokenizeLine(std::string_view(line).substr(0, max_pos),
+                 tokens, instance_->completionStorage_);
+
     if (tokens.empty()) {
         return nullptr;
     }
-    
-    std::string cmd = tokens[0];
-    auto it = instance_->commands_.find(cmd);
-    
+
+    auto reg = instance_->registry();
+    const CommandInfo* cmdInfo = reg->find(tokens[0]);
+
     // 如果命令不存在或没有参数补全函数，返回 nullptr
-    if (it == instance_->commands_.end() || !it->second.hasCompleter()) {
+    if (!cmdInfo || !cmdInfo->hasCompleter()) {
         return nullptr;
     }
-    
+
     // 当前参数的索引
     int paramIndex;
     if (strlen(text) == 0) {
@@ -375,33 +1914,48 @@ char** CLI::commandCompletion(const char* text, int start, int end)
     } else {
         paramIndex = tokens.size() - 1;
     }
-    
-    std::string currentInput(text);
-    
-    // 调用树形补全函数
-    std::vector<std::string> candidates = it->second.completer(tokens, paramIndex, currentInput);
-    
+
+    // 调用树形补全函数：优先走视图版，字符串版则物化一次 token
+    CARLINK_PROBE2(complete_entry, text, paramIndex);
+    std::vector<std::string> candidates;
+    if (cmdInfo->viewCompleter) {
+        candidates = cmdInfo->viewCompleter(tokens, paramIndex, std::string_view(text));
+    } else {
+        std::vector<std::string> ownedTokens(tokens.begin(), tokens.end());
+        candidates = cmdInfo->completer(ownedTokens, paramIndex, std::string(text));
+    }
+    CARLINK_PROBE2(complete_exit, text, candidates.size());
+
     // 如果没有补全候选，返回 nullptr，允许 readline 做文件补全
     if (candidates.empty()) {
         return nullptr;
     }
     
-    // 将补全候选转换为 readline 格式
+    // 将补全候选转换为 readline 格式。
+    // 集合的公共前缀等于字典序最小/最大两个元素的公共前缀，
+    // 不需要对每个候选做逐字符比较。
     std::string prefix = "";
     if (candidates.size() == 1) {
         prefix = candidates[0];
     } else if (candidates.size() > 1) {
-        prefix = candidates[0];
-        for (size_t i = 1; i < candidates.size(); ++i) {
-            size_t j = 0;
-            while (j < prefix.length() && j < candidates[i].length() && 
-                   prefix[j] == candidates[i][j]) {
-                j++;
-            }
-            prefix = prefix.substr(0, j);
+        auto [minIt, maxIt] = std::minmax_element(candidates.begin(), candidates.end());
+        size_t j = 0;
+        while (j < minIt->length() && j < maxIt->length() &&
+               (*minIt)[j] == (*maxIt)[j]) {
+            j++;
+        }
+        prefix = minIt->substr(0, j);
+
+        // 子串/模糊匹配模式下候选不一定以输入为前缀，公共前缀可能比
+        // 输入还短甚至毫不相干；此时替换槽保持用户已键入的内容，
+        // 只展示列表（单一候选仍然整词替换，这正是模糊选中的语义）
+        if (prefix.compare(0, strlen(text), text) != 0) {
+            prefix = text;
         }
     }
-    
+
+    // 指针数组和每个字符串都必须是独立的 malloc 块：readline 在展示后
+    // 用 free() 逐个释放它们，池化/arena 内存交给 readline 会被错误释放
     char** completions = (char**)malloc((candidates.size() + 2) * sizeof(char*));
     completions[0] = strdup(prefix.c_str());
     for (size_t i = 0; i < candidates.size(); ++i) {
@@ -414,27 +1968,37 @@ char** CLI::commandCompletion(const char* text, int start, int end)
 
 char* CLI::commandGenerator(const char* text, int state)
 {
-    static std::vector<std::string> matches;
+    // 匹配集是注册表名字数组里的连续区间，只记下标、不复制字符串。
+    // 交给 readline 的每个串仍需单独 malloc —— readline 会逐个 free。
+    static std::shared_ptr<const Registry> reg;
     static size_t matchIndex;
+    static size_t matchEnd;
 
     if (state == 0) {
-        matches.clear();
-        matchIndex = 0;
-
-        std::string prefix(text);
-        auto commands = instance_->getCommandList();
-
-        for (const auto& cmd : commands) {
-            if (cmd.find(prefix) == 0) {
-                matches.push_back(cmd);
+        // 注册表名字数组有序，拥有该前缀的命令是连续区间，二分定位
+        reg = instance_->registry();
+        std::string_view prefix(text);
+        auto first = std::lower_bound(reg->names.begin(), reg->names.end(), prefix,
+                                      [](const std::string& a, std::string_view b) {
+                                          return std::string_view(a) < b;
+                                      });
+        matchIndex = first - reg->names.begin();
+        matchEnd = matchIndex;
+        while (matchEnd < reg->names.size()) {
+            std::string_view name(reg->names[matchEnd]);
+            if (name.length() < prefix.length() ||
+                name.compare(0, prefix.length(), prefix) != 0) {
+                break;
             }
+            ++matchEnd;
         }
     }
 
-    if (matchIndex < matches.size()) {
-        return strdup(matches[matchIndex++].c_str());
+    if (matchIndex < matchEnd) {
+        return strdup(reg->names[matchIndex++].c_str());
     }
 
+    reg.reset();   // 本轮结束，不长期持有快照
     return nullptr;
 }
 
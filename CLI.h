@@ -1,12 +1,20 @@
 #pragma once
 
-#include <cerrno>
+#include <algorithm>
 #include <atomic>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
 #include <cstdlib>
+#include <cstring>
 #include <functional>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <vector>
 
 namespace carlink {
@@ -30,9 +38,119 @@ using TreeCompleter = std::function<std::vector<std::string>(
     const std::string& currentInput              // 当前输入
     )>;
 
+// 视图版补全函数：token 以 string_view 形式传入，补全热路径不发生字符串拷贝
+using TreeViewCompleter = std::function<std::vector<std::string>(
+    const std::vector<std::string_view>& allTokens,   // 所有已输入的 token（包括命令名）
+    int paramIndex,                                   // 当前补全的参数位置
+    std::string_view currentInput                     // 当前输入
+    )>;
+
 // 参数验证器类型 - 返回空字符串表示通过，返回错误消息表示失败
 using ParamValidator = std::function<std::string(const std::vector<std::string>& args)>;
 
+/**
+ * 零拷贝分词器：把一行命令切成 string_view 序列。
+ * - 空白分隔；支持单/双引号成组，反斜杠转义下一个字符
+ * - 无引号无转义的 ';' 和 '|' 自成一个 token（命令串接/管道分隔符，
+ *   见 executeCommand），引号或转义内的保持字面值
+ * - 无引号无转义的 token 直接指向原行，不分配
+ * - 需要去引号/反转义的 token 写入 storage；storage 预留原行长度，
+ *   保证已生成的视图在本次调用结果的生命周期内稳定
+ * tokens 和 storage 由调用方持有并复用，稳态下整个分词过程零分配。
+ */
+inline void tokenizeLine(std::string_view line,
+                         std::vector<std::string_view>& tokens,
+                         std::string& storage)
+{
+    tokens.clear();
+    storage.clear();
+    storage.reserve(line.length());
+
+    std::size_t i = 0;
+    while (i < line.length()) {
+        while (i < line.length() && (line[i] == ' ' || line[i] == '\t')) {
+            ++i;
+        }
+        if (i >= line.length()) {
+            break;
+        }
+
+        // 分隔符自成一个 token，"a|b" 与 "a | b" 等价
+        if (line[i] == ';' || line[i] == '|') {
+            tokens.push_back(line.substr(i, 1));
+            ++i;
+            continue;
+        }
+
+        std::size_t tokenStart = i;
+        bool needsCopy = false;
+
+        // 快速路径：没有引号和转义时整段直接引用原行
+        while (i < line.length() && line[i] != ' ' && line[i] != '\t' &&
+               line[i] != ';' && line[i] != '|') {
+            if (line[i] == '"' || line[i] == '\'' || line[i] == '\\') {
+                needsCopy = true;
+                break;
+            }
+            ++i;
+        }
+        if (!needsCopy) {
+            tokens.push_back(line.substr(tokenStart, i - tokenStart));
+            continue;
+        }
+
+        // 慢速路径：去引号/反转义后写入 storage
+        std::size_t storageStart = storage.length();
+        storage.append(line.substr(tokenStart, i - tokenStart));
+        char quote = 0;
+        while (i < line.length()) {
+            char c = line[i];
+            if (quote) {
+                if (c == quote) {
+                    quote = 0;
+                    ++i;
+                } else if (c == '\\' && quote == '"' && i + 1 < line.length()) {
+                    storage.push_back(line[i + 1]);
+                    i += 2;
+                } else {
+                    storage.push_back(c);
+                    ++i;
+                }
+                continue;
+            }
+            if (c == '"' || c == '\'') {
+                quote = c;
+                ++i;
+                continue;
+            }
+            if (c == '\\') {
+                if (i + 1 < line.length()) {
+                    storage.push_back(line[i + 1]);
+                    i += 2;
+                } else {
+                    ++i;
+                }
+                continue;
+            }
+            if (c == ' ' || c == '\t' || c == ';' || c == '|') {
+                break;
+            }
+            storage.push_back(c);
+            ++i;
+        }
+        tokens.push_back(std::string_view(storage.data() + storageStart,
+                                          storage.length() - storageStart));
+    }
+}
+
+// 便捷形式：一次性返回 token 列表（需要 storage 一起存活）
+inline std::vector<std::string_view> tokenizeLine(std::string_view line, std::string& storage)
+{
+    std::vector<std::string_view> tokens;
+    tokenizeLine(line, tokens, storage);
+    return tokens;
+}
+
 /**
  * 树形参数节点 - 支持任意深度的参数依赖关系
  * candidates: 当前位置可选的值列表（空列表表示数值型参数）
@@ -52,6 +170,17 @@ struct ParamNode {
 
 class TreeBuilder {
 public:
+    /**
+     * 批量加载条目：path 为从根出发的 key 序列，
+     * candidates / numeric 的语义与 node() / numeric() 一致
+     * （numeric.enabled 为真时忽略 candidates）。
+     */
+    struct Entry {
+        std::vector<std::string> path;
+        std::vector<std::string> candidates;
+        ParamNode::NumericConstraint numeric;
+    };
+
     explicit TreeBuilder(ParamNode& root)
         : root_(root) {}
 
@@ -83,10 +212,563 @@ public:
         return *this;
     }
 
+    /**
+     * 批量加载按 path 字典序预排序的条目列表。
+     *
+     * node() / numeric() 每次调用都从根重新下走一遍路径，生成 N 条叶子
+     * 路径的树要付出 O(N·depth·log fanout) 的 map 查找。这里利用排序后
+     * 相邻条目共享路径前缀的性质：维护一个节点栈，公共前缀直接复用，
+     * 新增的 key 必然落在父节点 children 的末尾，用 emplace_hint(end)
+     * 追加，整体构建退化为一次线性扫描。
+     */
+    TreeBuilder& load(std::vector<Entry> entries)
+    {
+        std::vector<std::string> currentPath;
+        std::vector<ParamNode*> stack;
+        stack.push_back(&root_);
+
+        for (auto& entry : entries) {
+            // 与上一条路径的公共前缀可以直接复用栈上已解析的节点
+            std::size_t common = 0;
+            while (common < currentPath.size() && common < entry.path.size() &&
+                   currentPath[common] == entry.path[common]) {
+                ++common;
+            }
+            currentPath.resize(common);
+            stack.resize(common + 1);
+
+            for (std::size_t depth = common; depth < entry.path.size(); ++depth) {
+                ParamNode& parent = *stack.back();
+                auto it = parent.children.emplace_hint(parent.children.end(),
+                                                       entry.path[depth], ParamNode{});
+                stack.push_back(&it->second);
+                currentPath.push_back(std::move(entry.path[depth]));
+            }
+
+            ParamNode& node = *stack.back();
+            if (entry.numeric.enabled) {
+                node.candidates.clear();
+                node.numeric = entry.numeric;
+            } else {
+                node.candidates = std::move(entry.candidates);
+            }
+        }
+        return *this;
+    }
+
+    /**
+     * 冻结构建完成的树并返回可直接注册的补全器/验证器。
+     * 等价于 makeTreeParamMap(std::move(root))：冻结后立即释放
+     * 构建期的 ParamNode 存储，源树变为空树，不发生任何深拷贝。
+     */
+    std::pair<TreeCompleter, ParamValidator> freeze();
+
 private:
     ParamNode& root_;
 };
 
+/**
+ * 冻结的参数树 —— ParamNode 树的只读紧凑表示
+ *
+ * ParamNode 用 std::map 存子节点，每个节点、每个字符串都是独立的堆分配，
+ * 大树（数万节点）会退化成指针追逐的红黑树森林，补全和验证时 dcache 命中率极差。
+ * FrozenTree 在注册时一次性把整棵树压平：
+ * - 所有节点按 BFS 序放进一个连续数组，子节点表现为 [childBegin, childEnd) 区间
+ * - 所有候选串和子节点 key 打包进同一个字符 arena，节点只持有 偏移+长度
+ * - 子节点 key 区间内按字典序排列（继承自 std::map 的遍历序），查找用二分
+ *
+ * 冻结后不可修改；构建阶段仍然使用 ParamNode / TreeBuilder。
+ */
+class FrozenTree {
+public:
+    // 定宽字段，保证节点数组布局紧凑、可整块拷贝
+    struct StrRef {
+        std::uint32_t offset;
+        std::uint32_t length;
+    };
+
+    struct Node {
+        std::uint32_t candBegin;    // [candBegin, candEnd) 为候选值区间
+        std::uint32_t candEnd;
+        std::uint32_t childBegin;   // [childBegin, childEnd) 为子节点边区间
+        std::uint32_t childEnd;
+        std::int64_t numMin;        // 数值约束，numEnabled 非零时生效
+        std::int64_t numMax;
+        std::uint32_t numEnabled;
+        std::uint32_t reserved;
+    };
+
+    static constexpr std::uint32_t INVALID_NODE = 0xFFFFFFFFu;
+
+    FrozenTree() = default;
+    ~FrozenTree();
+
+    // 存储要么自有、要么是 mmap 映射，禁止拷贝
+    FrozenTree(const FrozenTree&) = delete;
+    FrozenTree& operator=(const FrozenTree&) = delete;
+
+    // 把 ParamNode 树压平为冻结表示（单次遍历，构建后源树不再被引用）
+    static std::shared_ptr<const FrozenTree> build(const ParamNode& root);
+
+    /**
+     * 把冻结树写入二进制文件。格式为定宽头部 + 原样落盘的各数组，
+     * 在集成阶段生成一次，运行期用 load() 映射。
+     * @return 写入成功返回 true
+     */
+    bool dump(const std::string& path) const;
+
+    /**
+     * 以只读 mmap 方式加载 dump() 生成的文件。
+     * 节点、候选串引用和字符 arena 直接指向映射区，
+     * 零解析、零逐节点分配，冷启动成本只有一次 mmap。
+     * @return 失败（文件不存在 / 格式或版本不符）返回 nullptr
+     */
+    static std::shared_ptr<const FrozenTree> load(const std::string& path);
+
+    /**
+     * 把读取视图绑定到调用方持有的静态数组（见 buildStaticTree）。
+     * 不拷贝、不接管所有权，数组必须在树的生命周期内保持有效 ——
+     * 对 constexpr 数据这自然成立，它们就住在只读段里。
+     */
+    static std::shared_ptr<const FrozenTree> bindStatic(const char* arena, std::size_t arenaSize,
+                                                        const Node* nodes, std::size_t nodeCount,
+                                                        const StrRef* candidates, std::size_t candCount,
+                                                        const StrRef* childKeys,
+                                                        const std::uint32_t* childNodes,
+                                                        std::size_t childCount)
+    {
+        auto tree = std::make_shared<FrozenTree>();
+        tree->arenaData_ = arena;
+        tree->arenaSize_ = arenaSize;
+        tree->nodeData_ = nodes;
+        tree->nodeCount_ = nodeCount;
+        tree->candData_ = candidates;
+        tree->candCount_ = candCount;
+        tree->childKeyData_ = childKeys;
+        tree->childNodeData_ = childNodes;
+        tree->childCount_ = childCount;
+        return tree;
+    }
+
+    const Node& node(std::uint32_t index) const { return nodeData_[index]; }
+
+    std::string_view view(const StrRef& ref) const
+    {
+        return std::string_view(arenaData_ + ref.offset, ref.length);
+    }
+
+    std::string_view candidate(std::uint32_t index) const
+    {
+        return view(candData_[index]);
+    }
+
+    std::string_view childKey(std::uint32_t index) const
+    {
+        return view(childKeyData_[index]);
+    }
+
+    /**
+     * 候选区间按字典序存放（build 时排序），因此给定前缀的所有候选
+     * 构成连续子区间。返回 [first, last)，用两次二分代替整段线性扫描。
+     */
+    std::pair<std::uint32_t, std::uint32_t> candidatePrefixRange(const Node& node,
+                                                                 std::string_view prefix) const
+    {
+        // 第一个 >= prefix 的候选
+        std::uint32_t lo = node.candBegin;
+        std::uint32_t hi = node.candEnd;
+        while (lo < hi) {
+            std::uint32_t mid = lo + (hi - lo) / 2;
+            if (view(candData_[mid]).compare(prefix) < 0) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        std::uint32_t first = lo;
+
+        // 自 first 起，拥有该前缀的候选是前缀连续段，再二分出右端点
+        hi = node.candEnd;
+        while (lo < hi) {
+            std::uint32_t mid = lo + (hi - lo) / 2;
+            std::string_view cand = view(candData_[mid]);
+            bool hasPrefix = cand.length() >= prefix.length() &&
+                             cand.compare(0, prefix.length(), prefix) == 0;
+            if (hasPrefix) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        return {first, lo};
+    }
+
+    // 在候选区间内二分精确查找，返回候选下标或 INVALID_NODE
+    std::uint32_t findCandidate(const Node& node, std::string_view value) const
+    {
+        std::uint32_t lo = node.candBegin;
+        std::uint32_t hi = node.candEnd;
+        while (lo < hi) {
+            std::uint32_t mid = lo + (hi - lo) / 2;
+            int cmp = view(candData_[mid]).compare(value);
+            if (cmp == 0) {
+                return mid;
+            }
+            if (cmp < 0) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        return INVALID_NODE;
+    }
+
+    // 在 parent 的子节点边区间内二分查找 key，返回子节点下标或 INVALID_NODE
+    std::uint32_t findChild(const Node& parent, std::string_view key) const
+    {
+        std::uint32_t lo = parent.childBegin;
+        std::uint32_t hi = parent.childEnd;
+        while (lo < hi) {
+            std::uint32_t mid = lo + (hi - lo) / 2;
+            int cmp = view(childKeyData_[mid]).compare(key);
+            if (cmp == 0) {
+                return childNodeData_[mid];
+            }
+            if (cmp < 0) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        return INVALID_NODE;
+    }
+
+private:
+    StrRef addString(const std::string& value)
+    {
+        StrRef ref{static_cast<std::uint32_t>(arena_.length()),
+                   static_cast<std::uint32_t>(value.length())};
+        arena_.append(value);
+        return ref;
+    }
+
+    /**
+     * 构建期字符串驻留：同一内容只进 arena 一次，后续出现复用同一个
+     * StrRef。生成的树里 "on"/"off" 之类的候选会重复几万次，驻留让
+     * arena（以及 dump 文件）只为每个不同串付一份成本。pool 只在
+     * build() 期间存在，冻结完成即释放。
+     */
+    StrRef internString(const std::string& value, std::map<std::string, StrRef>& pool)
+    {
+        auto it = pool.lower_bound(value);
+        if (it != pool.end() && it->first == value) {
+            return it->second;
+        }
+        StrRef ref = addString(value);
+        pool.emplace_hint(it, value, ref);
+        return ref;
+    }
+
+    // 自有存储填充完毕后，把读取视图指向它
+    void bindOwned()
+    {
+        arenaData_ = arena_.data();
+        arenaSize_ = arena_.length();
+        nodeData_ = nodes_.data();
+        nodeCount_ = nodes_.size();
+        candData_ = candidates_.data();
+        candCount_ = candidates_.size();
+        childKeyData_ = childKeys_.data();
+        childNodeData_ = childNodes_.data();
+        childCount_ = childKeys_.size();
+    }
+
+    // 读取视图 —— 指向自有存储或 mmap 映射，所有访问接口只经过这些指针
+    const char* arenaData_ = nullptr;
+    std::size_t arenaSize_ = 0;
+    const Node* nodeData_ = nullptr;
+    std::size_t nodeCount_ = 0;
+    const StrRef* candData_ = nullptr;
+    std::size_t candCount_ = 0;
+    const StrRef* childKeyData_ = nullptr;
+    const std::uint32_t* childNodeData_ = nullptr;
+    std::size_t childCount_ = 0;
+
+    // 自有存储（build() 时填充）
+    std::string arena_;                      // 所有字符串的连续存储
+    std::vector<Node> nodes_;                // BFS 序的节点数组，0 为根
+    std::vector<StrRef> candidates_;         // 全部候选值，按节点分段
+    std::vector<StrRef> childKeys_;          // 全部子节点 key，与 childNodes_ 平行
+    std::vector<std::uint32_t> childNodes_;  // key 对应的子节点下标
+
+    // mmap 映射（load() 时填充，析构时解除映射）
+    void* mapBase_ = nullptr;
+    std::size_t mapSize_ = 0;
+};
+
+inline std::shared_ptr<const FrozenTree> FrozenTree::build(const ParamNode& root)
+{
+    auto tree = std::make_shared<FrozenTree>();
+
+    // 驻留池：内容 -> 已入 arena 的引用，整个构建过程共享
+    std::map<std::string, StrRef> pool;
+
+    // BFS 展开，pending 的下标即节点编号，保证每个节点的子节点边连续存放
+    std::vector<const ParamNode*> pending;
+    pending.push_back(&root);
+
+    for (std::size_t i = 0; i < pending.size(); ++i) {
+        const ParamNode* src = pending[i];
+
+        Node node{};
+        node.candBegin = static_cast<std::uint32_t>(tree->candidates_.size());
+        for (const auto& candidate : src->candidates) {
+            tree->candidates_.push_back(tree->internString(candidate, pool));
+        }
+        node.candEnd = static_cast<std::uint32_t>(tree->candidates_.size());
+
+        // 候选段按字典序排序，前缀匹配和成员检查都走二分（见 candidatePrefixRange）。
+        // 此时读取视图尚未绑定，直接基于自有 arena 比较。
+        const std::string& arena = tree->arena_;
+        std::sort(tree->candidates_.begin() + node.candBegin,
+                  tree->candidates_.end(),
+                  [&arena](const StrRef& a, const StrRef& b) {
+                      return std::string_view(arena.data() + a.offset, a.length) <
+                             std::string_view(arena.data() + b.offset, b.length);
+                  });
+
+        node.childBegin = static_cast<std::uint32_t>(tree->childKeys_.size());
+        for (const auto& [key, child] : src->children) {
+            tree->childKeys_.push_back(tree->internString(key, pool));
+            tree->childNodes_.push_back(static_cast<std::uint32_t>(pending.size()));
+            pending.push_back(&child);
+        }
+        node.childEnd = static_cast<std::uint32_t>(tree->childKeys_.size());
+
+        node.numEnabled = src->numeric.enabled ? 1 : 0;
+        node.numMin = src->numeric.minValue;
+        node.numMax = src->numeric.maxValue;
+
+        tree->nodes_.push_back(node);
+    }
+
+    tree->bindOwned();
+    return tree;
+}
+
+/**
+ * 编译期命令树 —— 运行期完全零构建开销的 FrozenTree
+ *
+ * 大部分命令的参数树在编译时就完全确定，为它们在启动时跑一遍
+ * TreeBuilder（堆节点、map 插入、BFS 压平）是纯浪费。下面的 DSL
+ * 允许把树写成 constexpr 数据：buildStaticTree() 在编译期完成
+ * 建树、BFS 压平、子节点 key 与候选段排序和 arena 打包，产物是
+ * 一个可放进只读段的聚合体，进程间共享且不占用任何动态内存。
+ * bindStatic() 把 FrozenTree 的读取视图直接指向这些静态数组，
+ * 之后走与运行期构建的树完全相同的补全 / 验证路径。
+ *
+ * 用法示例:
+ * constexpr const char* kSetPath[] = {"volume"};
+ * constexpr const char* kOnOff[] = {"on", "off"};
+ * constexpr StaticTreeEntry kEntries[] = {
+ *     staticRoot(kOnOff),
+ *     staticNumeric(kSetPath, 1, 600),
+ * };
+ * constexpr auto kTree = buildStaticTree<8, 8, 64>(kEntries);
+ * auto [completer, validator] = makeTreeParamMapView(kTree);
+ */
+struct StaticTreeEntry {
+    const char* const* path;          // 从根出发的 key 序列
+    std::size_t pathLength;
+    const char* const* candidates;    // 目标节点的候选值
+    std::size_t candidateCount;
+    bool numeric;
+    long numMin;
+    long numMax;
+};
+
+// 根节点的候选值
+template <std::size_t C>
+constexpr StaticTreeEntry staticRoot(const char* const (&candidates)[C])
+{
+    return StaticTreeEntry{nullptr, 0, candidates, C, false, 0, 0};
+}
+
+// path 处的候选值节点
+template <std::size_t P, std::size_t C>
+constexpr StaticTreeEntry staticNode(const char* const (&path)[P],
+                                     const char* const (&candidates)[C])
+{
+    return StaticTreeEntry{path, P, candidates, C, false, 0, 0};
+}
+
+// path 处的数值约束节点
+template <std::size_t P>
+constexpr StaticTreeEntry staticNumeric(const char* const (&path)[P],
+                                        long minValue, long maxValue)
+{
+    return StaticTreeEntry{path, P, nullptr, 0, true, minValue, maxValue};
+}
+
+/**
+ * buildStaticTree 的产物。容量参数允许留有余量（多余槽位是零填充，
+ * 躺在只读段里不占运行期内存），计数字段给出实际规模。
+ */
+template <std::size_t NodeCap, std::size_t CandCap, std::size_t ArenaCap>
+struct StaticTreeStorage {
+    char arena[ArenaCap] = {};
+    FrozenTree::Node nodes[NodeCap] = {};
+    FrozenTree::StrRef candidates[CandCap] = {};
+    FrozenTree::StrRef childKeys[NodeCap] = {};      // 边数 < 节点数，NodeCap 必然够用
+    std::uint32_t childNodes[NodeCap] = {};
+    std::uint32_t nodeCount = 0;
+    std::uint32_t candCount = 0;
+    std::uint32_t childCount = 0;
+    std::uint32_t arenaSize = 0;
+};
+
+/**
+ * 在编译期把条目列表压平为 FrozenTree 布局的静态数组。
+ * 容量不足时求值失败（throw 在常量求值里直接变成编译错误），
+ * 不会产出截断的树。Entries 只需可迭代出 StaticTreeEntry。
+ */
+template <std::size_t NodeCap, std::size_t CandCap, std::size_t ArenaCap, typename Entries>
+constexpr StaticTreeStorage<NodeCap, CandCap, ArenaCap> buildStaticTree(const Entries& entries)
+{
+    // 编译期字符串比较（strcmp 不是 constexpr）
+    auto compare = [](const char* a, const char* b) constexpr -> int {
+        std::size_t i = 0;
+        while (a[i] != '\0' && a[i] == b[i]) ++i;
+        if (a[i] == b[i]) return 0;
+        return (unsigned char)a[i] < (unsigned char)b[i] ? -1 : 1;
+    };
+
+    // 中间表示：兄弟按 key 有序串成链表，BFS 输出时段内自然有序
+    struct Tmp {
+        const char* key;
+        int firstChild;
+        int nextSibling;
+        const char* const* candidates;
+        std::size_t candidateCount;
+        bool numeric;
+        long numMin;
+        long numMax;
+    };
+    Tmp tmp[NodeCap] = {};
+    std::size_t tmpCount = 1;
+    tmp[0] = Tmp{nullptr, -1, -1, nullptr, 0, false, 0, 0};
+
+    for (const StaticTreeEntry& entry : entries) {
+        int current = 0;
+        for (std::size_t depth = 0; depth < entry.pathLength; ++depth) {
+            const char* key = entry.path[depth];
+            // 在有序兄弟链里查找，缺失时原位插入保持有序
+            int prev = -1;
+            int child = tmp[current].firstChild;
+            while (child != -1 && compare(tmp[child].key, key) < 0) {
+                prev = child;
+                child = tmp[child].nextSibling;
+            }
+            if (child == -1 || compare(tmp[child].key, key) != 0) {
+                if (tmpCount >= NodeCap) throw "static tree: NodeCap exceeded";
+                int fresh = (int)tmpCount++;
+                tmp[fresh] = Tmp{key, -1, child, nullptr, 0, false, 0, 0};
+                if (prev == -1) {
+                    tmp[current].firstChild = fresh;
+                } else {
+                    tmp[prev].nextSibling = fresh;
+                }
+                child = fresh;
+            }
+            current = child;
+        }
+        if (entry.numeric) {
+            tmp[current].numeric = true;
+            tmp[current].numMin = entry.numMin;
+            tmp[current].numMax = entry.numMax;
+        } else {
+            tmp[current].candidates = entry.candidates;
+            tmp[current].candidateCount = entry.candidateCount;
+        }
+    }
+
+    StaticTreeStorage<NodeCap, CandCap, ArenaCap> out{};
+
+    auto addString = [&out](const char* value) constexpr -> FrozenTree::StrRef {
+        std::uint32_t length = 0;
+        while (value[length] != '\0') ++length;
+        // 驻留：已打包内容里出现过的串（含作为子串出现）直接复用
+        for (std::uint32_t start = 0; start + length <= out.arenaSize; ++start) {
+            std::uint32_t i = 0;
+            while (i < length && out.arena[start + i] == value[i]) ++i;
+            if (i == length) {
+                return FrozenTree::StrRef{start, length};
+            }
+        }
+        std::uint32_t offset = out.arenaSize;
+        for (std::uint32_t i = 0; i < length; ++i) {
+            if (out.arenaSize >= ArenaCap) throw "static tree: ArenaCap exceeded";
+            out.arena[out.arenaSize++] = value[i];
+        }
+        return FrozenTree::StrRef{offset, length};
+    };
+
+    // BFS 布局：order 既是队列也是 tmp 下标 -> 最终节点编号的映射
+    std::size_t order[NodeCap] = {};
+    std::size_t head = 0;
+    std::size_t tail = 1;
+    order[0] = 0;
+
+    while (head < tail) {
+        const Tmp& src = tmp[order[head]];
+        FrozenTree::Node& node = out.nodes[head];
+
+        node.candBegin = out.candCount;
+        for (std::size_t c = 0; c < src.candidateCount; ++c) {
+            if (out.candCount >= CandCap) throw "static tree: CandCap exceeded";
+            out.candidates[out.candCount++] = addString(src.candidates[c]);
+        }
+        node.candEnd = out.candCount;
+        // 候选段排序（插入排序，段都很短），与 build() 的不变式一致。
+        // arena 内字符串无终止符，必须按 偏移+长度 比较
+        auto refLess = [&out](const FrozenTree::StrRef& a, const FrozenTree::StrRef& b) constexpr -> bool {
+            std::uint32_t n = a.length < b.length ? a.length : b.length;
+            for (std::uint32_t i = 0; i < n; ++i) {
+                char ca = out.arena[a.offset + i];
+                char cb = out.arena[b.offset + i];
+                if (ca != cb) return (unsigned char)ca < (unsigned char)cb;
+            }
+            return a.length < b.length;
+        };
+        for (std::uint32_t i = node.candBegin + 1; i < node.candEnd; ++i) {
+            FrozenTree::StrRef key = out.candidates[i];
+            std::uint32_t j = i;
+            while (j > node.candBegin && refLess(key, out.candidates[j - 1])) {
+                out.candidates[j] = out.candidates[j - 1];
+                --j;
+            }
+            out.candidates[j] = key;
+        }
+
+        node.childBegin = out.childCount;
+        for (int child = src.firstChild; child != -1; child = tmp[child].nextSibling) {
+            out.childKeys[out.childCount] = addString(tmp[child].key);
+            out.childNodes[out.childCount] = (std::uint32_t)tail;
+            ++out.childCount;
+            order[tail++] = (std::size_t)child;
+        }
+        node.childEnd = out.childCount;
+
+        node.numEnabled = src.numeric ? 1 : 0;
+        node.numMin = src.numMin;
+        node.numMax = src.numMax;
+        ++head;
+    }
+    out.nodeCount = (std::uint32_t)tail;
+
+    return out;
+}
+
 
 /**
  * 创建树形依赖的补全器和验证器
@@ -106,120 +788,310 @@ private:
  * auto [completer, validator] = makeTreeParamMap(root);
  * cli.registerCommand("set", "Set configuration", handler, completer, validator);
  */
-inline std::pair<TreeCompleter, ParamValidator> makeTreeParamMap(const ParamNode& root)
+/**
+ * 候选匹配模式
+ * - Prefix：默认，沿用排序段二分出前缀区间
+ * - Substring：输入出现在候选任意位置即命中，越靠前、候选越短得分越高
+ * - Fuzzy：输入是候选的子序列即命中（fzf 风格），连续命中和词首命中加分
+ *
+ * 数千个信号名的候选集下，操作员往往只记得名字中间的片段；
+ * 后两种模式让补全按相关度排序返回，扫描核心用 memchr 跳到下一个
+ * 可能的命中字节（libc 内部即向量化实现），整段 arena 连续存放，
+ * 大候选集单次按键仍在亚毫秒级。
+ */
+enum class MatchMode {
+    Prefix,
+    Substring,
+    Fuzzy,
+};
+
+// 子串查找：memchr 定位首字节候选位置 + memcmp 验证，返回位置或 -1
+inline int substringFindAt(std::string_view hay, std::string_view needle)
 {
-    // 使用 shared_ptr 确保树的生命周期
-    auto rootPtr = std::make_shared<ParamNode>(root);
-    
-    auto completer = [rootPtr](const std::vector<std::string>& allTokens, int paramIndex, const std::string& input) -> std::vector<std::string> {
+    if (needle.empty()) return 0;
+    if (hay.length() < needle.length()) return -1;
+    const char* p = hay.data();
+    const char* searchEnd = hay.data() + hay.length() - needle.length() + 1;
+    while (p < searchEnd) {
+        const void* hit = std::memchr(p, needle[0], static_cast<std::size_t>(searchEnd - p));
+        if (hit == nullptr) return -1;
+        p = static_cast<const char*>(hit);
+        if (std::memcmp(p, needle.data(), needle.length()) == 0) {
+            return static_cast<int>(p - hay.data());
+        }
+        ++p;
+    }
+    return -1;
+}
+
+/**
+ * fzf 风格子序列评分：贪心取每个模式字符在候选里的最左出现
+ * （memchr 逐字符跳跃），连续命中 +8、词首命中 +6、命中本身 +4，
+ * 多余长度每字符 -1。不构成子序列返回 false。
+ */
+inline bool fuzzySubsequenceScore(std::string_view candidate, std::string_view pattern, int& outScore)
+{
+    if (pattern.empty()) {
+        outScore = 0;
+        return true;
+    }
+    int score = 0;
+    int lastMatch = -2;
+    std::size_t pos = 0;
+    for (std::size_t pi = 0; pi < pattern.length(); ++pi) {
+        if (pos >= candidate.length()) return false;
+        const void* hit = std::memchr(candidate.data() + pos, pattern[pi], candidate.length() - pos);
+        if (hit == nullptr) return false;
+        std::size_t i = static_cast<std::size_t>(static_cast<const char*>(hit) - candidate.data());
+        score += 4;
+        if (static_cast<int>(i) == lastMatch + 1) score += 8;
+        if (i == 0 || candidate[i - 1] == '_' || candidate[i - 1] == '-' || candidate[i - 1] == '.') {
+            score += 6;
+        }
+        lastMatch = static_cast<int>(i);
+        pos = i + 1;
+    }
+    score -= static_cast<int>(candidate.length() - pattern.length());
+    outScore = score;
+    return true;
+}
+
+/**
+ * 按模式在节点候选段上收集匹配并按相关度排序。
+ * Prefix 模式不经过这里（有序段二分更便宜）。
+ */
+inline std::vector<std::string> rankedCandidateMatches(const FrozenTree& tree,
+                                                       const FrozenTree::Node& node,
+                                                       std::string_view input,
+                                                       MatchMode mode)
+{
+    std::vector<std::pair<int, std::uint32_t>> scored;
+    for (std::uint32_t c = node.candBegin; c < node.candEnd; ++c) {
+        std::string_view cand = tree.candidate(c);
+        if (mode == MatchMode::Substring) {
+            int pos = substringFindAt(cand, input);
+            if (pos < 0) continue;
+            // 命中越靠前、剩余越短越相关（直接作为代价，越小越好）
+            scored.emplace_back(pos * 4 + static_cast<int>(cand.length() - input.length()), c);
+        } else {
+            int score = 0;
+            if (!fuzzySubsequenceScore(cand, input, score)) continue;
+            scored.emplace_back(-score, c);
+        }
+    }
+    // 统一存成代价（模糊分取负），升序即相关度降序，同分按候选段原序（字典序）
+    std::sort(scored.begin(), scored.end());
+    std::vector<std::string> matches;
+    matches.reserve(scored.size());
+    for (const auto& [negScore, c] : scored) {
+        matches.emplace_back(tree.candidate(c));
+    }
+    return matches;
+}
+
+/**
+ * 数值节点的虚拟候选：按需生成 [numMin, numMax] 中以当前输入为十进制
+ * 前缀的数值，不为整个区间物化候选字符串。
+ * - 输入为空：区间足够小（<= 上限）时枚举整个区间，否则不给候选
+ * - 输入是数字：从该值出发按十进制前缀扩展（v, v*10+d, ...），
+ *   越界分支整支剪掉，最多返回上限个
+ */
+inline std::vector<std::string> numericRangeMatches(const FrozenTree::Node& node,
+                                                    std::string_view input)
+{
+    constexpr std::size_t MAX_MATCHES = 100;
+    std::vector<std::string> matches;
+    const std::int64_t min = node.numMin;
+    const std::int64_t max = node.numMax;
+
+    if (input.empty()) {
+        if (max >= min && max - min + 1 <= (std::int64_t)MAX_MATCHES) {
+            for (std::int64_t v = min; v <= max; ++v) {
+                matches.push_back(std::to_string(v));
+            }
+        }
+        return matches;
+    }
+
+    std::int64_t base = 0;
+    auto result = std::from_chars(input.data(), input.data() + input.length(), base);
+    if (result.ec != std::errc() || result.ptr != input.data() + input.length()) {
+        return matches;
+    }
+
+    const bool negative = input[0] == '-';
+    std::vector<std::int64_t> frontier{base};
+    std::vector<std::int64_t> next;
+    while (!frontier.empty() && matches.size() < MAX_MATCHES) {
+        next.clear();
+        for (std::int64_t v : frontier) {
+            if (v >= min && v <= max) {
+                matches.push_back(std::to_string(v));
+                if (matches.size() >= MAX_MATCHES) {
+                    break;
+                }
+            }
+            if (v == 0) {
+                continue;   // "0"/"-0" 的十进制扩展会改变前缀
+            }
+            for (int d = 0; d <= 9; ++d) {
+                if (!negative) {
+                    if (v > max / 10) {
+                        break;   // 后代只会更大，整支剪掉
+                    }
+                    std::int64_t child = v * 10 + d;
+                    if (child <= max) {
+                        next.push_back(child);
+                    }
+                } else {
+                    if (v < min / 10) {
+                        break;   // 后代只会更小
+                    }
+                    std::int64_t child = v * 10 - d;
+                    if (child >= min) {
+                        next.push_back(child);
+                    }
+                }
+            }
+        }
+        frontier.swap(next);
+    }
+    std::sort(matches.begin(), matches.end());
+    return matches;
+}
+
+/**
+ * 视图版：直接包装一棵已冻结的树（FrozenTree::build 的结果或
+ * FrozenTree::load 映射的文件），补全路径上 token 全程以视图传递。
+ */
+inline std::pair<TreeViewCompleter, ParamValidator> makeTreeParamMapView(std::shared_ptr<const FrozenTree> tree,
+                                                                         MatchMode mode = MatchMode::Prefix)
+{
+    // 下降游标：记住上一次补全解析到的 token 路径和对应节点。
+    // 连续按键几乎总是共享路径前缀，于是每次只需解析变化的后缀，
+    // 深树上一次按键从整树下降变成一步 findChild。
+    // 树冻结后不可变，缓存永远不会失效；动态补全器不经过这里。
+    struct DescentCursor {
+        std::vector<std::string> path;          // 已解析的参数 token（不含命令名）
+        std::vector<std::uint32_t> nodes;       // path[i] 解析后到达的节点
+    };
+    auto cursor = std::make_shared<DescentCursor>();
+
+    auto completer = [tree, cursor, mode](const std::vector<std::string_view>& allTokens, int paramIndex, std::string_view input) -> std::vector<std::string> {
         if (paramIndex < 1) return {};
-        
-        const ParamNode* current = rootPtr.get();
-        if (!current) return {};
-        
-        // 遍历树找到当前节点
-        for (int i = 1; i < paramIndex; ++i) {
+
+        // 与缓存路径的公共前缀直接复用，无需重新下降
+        std::size_t common = 0;
+        while (common < cursor->path.size() &&
+               (int)common + 1 < paramIndex &&
+               common + 1 < allTokens.size() &&
+               std::string_view(cursor->path[common]) == allTokens[common + 1]) {
+            ++common;
+        }
+        cursor->path.resize(common);
+        cursor->nodes.resize(common);
+
+        std::uint32_t current = (common > 0) ? cursor->nodes[common - 1] : 0;
+
+        // 只解析变化的后缀
+        for (int i = (int)common + 1; i < paramIndex; ++i) {
             if (i >= (int)allTokens.size()) return {};
-            
-            const std::string& token = allTokens[i];
-            auto it = current->children.find(token);
-            if (it == current->children.end()) {
-                return {};  // 路径不存在
+
+            current = tree->findChild(tree->node(current), allTokens[i]);
+            if (current == FrozenTree::INVALID_NODE) {
+                return {};  // 路径不存在（失败不进缓存）
             }
-            current = &(it->second);
-            if (!current) return {};
+            cursor->path.emplace_back(allTokens[i]);
+            cursor->nodes.push_back(current);
         }
-        
-        // 返回当前节点的候选值（前缀匹配）
+
+        // 返回当前节点的候选值：二分出前缀区间后整段拷出
+        const FrozenTree::Node& node = tree->node(current);
+        if (node.candBegin == node.candEnd && node.numEnabled) {
+            // 纯数值节点：按需生成区间内的虚拟候选
+            return numericRangeMatches(node, input);
+        }
+        if (mode != MatchMode::Prefix && !input.empty()) {
+            return rankedCandidateMatches(*tree, node, input, mode);
+        }
+        auto [first, last] = tree->candidatePrefixRange(node, input);
         std::vector<std::string> matches;
-        for (const auto& candidate : current->candidates) {
-            if (candidate.find(input) == 0) {
-                matches.push_back(candidate);
-            }
+        matches.reserve(last - first);
+        for (std::uint32_t c = first; c < last; ++c) {
+            matches.emplace_back(tree->candidate(c));
         }
         return matches;
     };
-    
-    auto validator = [rootPtr](const std::vector<std::string>& args) -> std::string {
+
+    auto validator = [tree](const std::vector<std::string>& args) -> std::string {
         if (args.size() < 2) {
             return "Missing arguments";
         }
-        
-        const ParamNode* current = rootPtr.get();
-        if (!current) return "Internal error: invalid tree";
-        
+
+        std::uint32_t current = 0;
         bool lastValueIsLeaf = false;
-        
-        auto parseLong = [](const std::string& value, long& outValue) -> bool {
-            if (value.empty()) return false;
-            char* end = nullptr;
-            errno = 0;
-            long parsed = std::strtol(value.c_str(), &end, 10);
-            if (errno != 0 || end == value.c_str() || *end != '\0') {
-                return false;
+
+        // std::from_chars：不碰 errno、不受 locale 影响、直接吃字符区间
+        auto parseLong = [](const std::string& value, std::int64_t& outValue) -> bool {
+            const char* first = value.data();
+            const char* last = value.data() + value.length();
+            auto result = std::from_chars(first, last, outValue);
+            return result.ec == std::errc() && result.ptr == last;
+        };
+
+        auto joinCandidates = [&tree](const FrozenTree::Node& node) -> std::string {
+            std::string joined;
+            for (std::uint32_t c = node.candBegin; c < node.candEnd; ++c) {
+                if (!joined.empty()) joined += ", ";
+                joined += tree->candidate(c);
             }
-            outValue = parsed;
-            return true;
+            return joined;
         };
 
         for (size_t i = 1; i < args.size(); ++i) {
             const std::string& value = args[i];
             lastValueIsLeaf = false;
-            
-            if (!current) {
-                return "Internal error: null pointer";
-            }
-            
+
+            const FrozenTree::Node& node = tree->node(current);
+            bool hasCandidates = node.candBegin != node.candEnd;
+            bool hasChildren = node.childBegin != node.childEnd;
+
             // 如果候选列表为空，处理数值型参数
-            if (current->candidates.empty()) {
-                if (current->numeric.enabled) {
-                    long parsed = 0;
+            if (!hasCandidates) {
+                if (node.numEnabled) {
+                    std::int64_t parsed = 0;
                     if (!parseLong(value, parsed)) {
                         return "Invalid number '" + value + "' at position " + std::to_string(i);
                     }
-                    if (parsed < current->numeric.minValue || parsed > current->numeric.maxValue) {
+                    if (parsed < node.numMin || parsed > node.numMax) {
                         return "Number out of range at position " + std::to_string(i) +
-                               ". Expected: " + std::to_string(current->numeric.minValue) +
-                               " to " + std::to_string(current->numeric.maxValue);
+                               ". Expected: " + std::to_string(node.numMin) +
+                               " to " + std::to_string(node.numMax);
                     }
                 }
-                if (!current->children.empty()) {
-                    auto it = current->children.find(value);
-                    if (it != current->children.end()) {
-                        current = &(it->second);
+                if (hasChildren) {
+                    std::uint32_t next = tree->findChild(node, value);
+                    if (next != FrozenTree::INVALID_NODE) {
+                        current = next;
                         continue;
                     }
                 }
                 lastValueIsLeaf = true;
                 continue;
             }
-            
-            // 验证值是否在候选列表中
-            bool found = false;
-            for (const auto& candidate : current->candidates) {
-                if (value == candidate) {
-                    found = true;
-                    break;
-                }
-            }
-            
+
+            // 验证值是否在候选列表中（候选段有序，二分查找）
+            bool found = tree->findCandidate(node, value) != FrozenTree::INVALID_NODE;
+
             if (!found) {
-                std::string validValues;
-                for (const auto& v : current->candidates) {
-                    if (!validValues.empty()) validValues += ", ";
-                    validValues += v;
-                }
-                return "Invalid value '" + value + "' at position " + std::to_string(i) + 
-                       ". Valid values: " + validValues;
+                return "Invalid value '" + value + "' at position " + std::to_string(i) +
+                       ". Valid values: " + joinCandidates(node);
             }
-            
+
             // 尝试移动到子节点
-            auto it = current->children.find(value);
-            if (it != current->children.end()) {
-                current = &(it->second);
-                if (!current) {
-                    return "Internal error: null pointer after move";
-                }
+            std::uint32_t next = tree->findChild(node, value);
+            if (next != FrozenTree::INVALID_NODE) {
+                current = next;
                 lastValueIsLeaf = false;
             } else {
                 // 该值在candidates中，但没有子节点，是叶子值
@@ -230,68 +1102,341 @@ inline std::pair<TreeCompleter, ParamValidator> makeTreeParamMap(const ParamNode
                 break;
             }
         }
-        
+
         // 如果最后一个值是叶子值，验证通过
         if (lastValueIsLeaf) {
             return "";
         }
-        
+
         // 否则检查当前节点是否还需要更多参数
-        if (current && (!current->candidates.empty() || !current->children.empty())) {
-            if (!current->candidates.empty()) {
-                std::string currentOptions;
-                for (const auto& opt : current->candidates) {
-                    if (!currentOptions.empty()) currentOptions += ", ";
-                    currentOptions += opt;
-                }
-                return "Missing argument. Expected one of: " + currentOptions;
-            }
-            
-            if (!current->children.empty()) {
-                std::string nextOptions;
-                for (const auto& [key, _] : current->children) {
-                    if (!nextOptions.empty()) nextOptions += ", ";
-                    nextOptions += key;
-                }
-                return "Missing argument. Expected: " + nextOptions;
+        const FrozenTree::Node& node = tree->node(current);
+        if (node.candBegin != node.candEnd) {
+            return "Missing argument. Expected one of: " + joinCandidates(node);
+        }
+
+        if (node.childBegin != node.childEnd) {
+            std::string nextOptions;
+            for (std::uint32_t c = node.childBegin; c < node.childEnd; ++c) {
+                if (!nextOptions.empty()) nextOptions += ", ";
+                nextOptions += tree->childKey(c);
             }
+            return "Missing argument. Expected: " + nextOptions;
         }
-        
+
         return "";  // 验证通过
     };
-    
+
+    return {completer, validator};
+}
+
+/**
+ * 字符串版包装：保持原有 TreeCompleter 签名，内部转发到视图实现。
+ */
+inline std::pair<TreeCompleter, ParamValidator> makeTreeParamMap(std::shared_ptr<const FrozenTree> tree,
+                                                                 MatchMode mode = MatchMode::Prefix)
+{
+    auto [viewCompleter, validator] = makeTreeParamMapView(std::move(tree), mode);
+    TreeCompleter completer = [viewCompleter](const std::vector<std::string>& allTokens,
+                                              int paramIndex,
+                                              const std::string& input) {
+        std::vector<std::string_view> views(allTokens.begin(), allTokens.end());
+        return viewCompleter(views, paramIndex, input);
+    };
     return {completer, validator};
 }
 
+inline std::pair<TreeCompleter, ParamValidator> makeTreeParamMap(const ParamNode& root)
+{
+    // 注册时一次性冻结成连续表示，补全/验证只在紧凑数组上行走
+    return makeTreeParamMap(FrozenTree::build(root));
+}
+
+/**
+ * 静态树版：绑定 buildStaticTree() 的编译期产物。
+ * storage 必须具有静态存储期（constexpr 变量天然满足）。
+ */
+template <std::size_t NodeCap, std::size_t CandCap, std::size_t ArenaCap>
+inline std::pair<TreeViewCompleter, ParamValidator>
+makeTreeParamMapView(const StaticTreeStorage<NodeCap, CandCap, ArenaCap>& storage)
+{
+    return makeTreeParamMapView(FrozenTree::bindStatic(
+        storage.arena, storage.arenaSize,
+        storage.nodes, storage.nodeCount,
+        storage.candidates, storage.candCount,
+        storage.childKeys, storage.childNodes, storage.childCount));
+}
+
+template <std::size_t NodeCap, std::size_t CandCap, std::size_t ArenaCap>
+inline std::pair<TreeCompleter, ParamValidator>
+makeTreeParamMap(const StaticTreeStorage<NodeCap, CandCap, ArenaCap>& storage)
+{
+    return makeTreeParamMap(FrozenTree::bindStatic(
+        storage.arena, storage.arenaSize,
+        storage.nodes, storage.nodeCount,
+        storage.candidates, storage.candCount,
+        storage.childKeys, storage.childNodes, storage.childCount));
+}
+
+/**
+ * 移动版本：冻结后立即释放源树。
+ * 构建期的 ParamNode 树只在冻结时被读取一遍，之后不再需要；
+ * 连续注册多棵大树时，及时释放源树可以避免峰值内存翻倍。
+ */
+inline std::pair<TreeCompleter, ParamValidator> makeTreeParamMap(ParamNode&& root)
+{
+    auto result = makeTreeParamMap(static_cast<const ParamNode&>(root));
+    root = ParamNode{};
+    return result;
+}
+
+inline std::pair<TreeCompleter, ParamValidator> TreeBuilder::freeze()
+{
+    return makeTreeParamMap(std::move(root_));
+}
+
+/**
+ * 把慢速候选源（经 IPC 拉取在线 ECU 列表等）包装成带延迟预算的补全器。
+ *
+ * 补全器在 readline 线程上同步调用，候选源一慢整个终端就会卡住。
+ * 包装后的行为：每次补全触发一次后台刷新（已有在途刷新则复用），
+ * 在预算内等待结果 —— 按时完成就用新鲜数据应答，超时则立刻用上一次
+ * 的缓存快照应答，刷新继续在后台进行、下一次 Tab 看到新数据。
+ * 输入线程的阻塞上界永远是 budget，从不等待 IPC 本身。
+ *
+ * fetch 在后台线程执行，需自行保证线程安全；抛异常时保留旧快照。
+ * 候选按前缀过滤，快照内部按字典序保存。
+ */
+inline TreeViewCompleter makeAsyncCompleter(std::function<std::vector<std::string>()> fetch,
+                                            std::chrono::milliseconds budget = std::chrono::milliseconds(50))
+{
+    struct State {
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::vector<std::string> snapshot;   // 最近一次成功拉取的候选（有序）
+        bool fetching = false;
+    };
+    auto state = std::make_shared<State>();
+
+    return [state, fetch = std::move(fetch), budget](const std::vector<std::string_view>&,
+                                                     int,
+                                                     std::string_view input) -> std::vector<std::string> {
+        std::unique_lock<std::mutex> lock(state->mutex);
+
+        if (!state->fetching) {
+            state->fetching = true;
+            // 刷新线程只引用共享状态，生命周期与补全器解耦
+            std::thread([state, fetch]() {
+                std::vector<std::string> fresh;
+                bool ok = true;
+                try {
+                    fresh = fetch();
+                    std::sort(fresh.begin(), fresh.end());
+                }
+                catch (...) {
+                    ok = false;   // 保留旧快照
+                }
+                {
+                    std::lock_guard<std::mutex> refreshLock(state->mutex);
+                    if (ok) {
+                        state->snapshot = std::move(fresh);
+                    }
+                    state->fetching = false;
+                }
+                state->cv.notify_all();
+            }).detach();
+        }
+
+        // 预算内等待在途刷新；到点直接用现有快照应答
+        state->cv.wait_for(lock, budget, [&state]() { return !state->fetching; });
+
+        std::vector<std::string> matches;
+        for (const auto& cand : state->snapshot) {
+            if (cand.length() >= input.length() &&
+                std::string_view(cand).compare(0, input.length(), input) == 0) {
+                matches.push_back(cand);
+            }
+        }
+        return matches;
+    };
+}
+
+/**
+ * 批量输出缓冲
+ *
+ * 内置命令和处理函数的逐行 std::cout << ... << std::endl 每行强制一次
+ * 系统调用级别的刷新，在串口/SSH 上输出长内容时明显卡顿。OutputSink
+ * 把命令期间的输出聚集在一个可增长缓冲里，命令结束时一次性写出；
+ * 需要中途可见的进度输出可以显式调用 flush()。
+ */
+class OutputSink {
+public:
+    explicit OutputSink(int fd = 1)
+        : fd_(fd) {}
+
+    void write(std::string_view text) { buffer_.append(text); }
+
+    void writeLine(std::string_view text)
+    {
+        buffer_.append(text);
+        buffer_.push_back('\n');
+    }
+
+    // 把缓冲内容一次性写到目标 fd 并清空缓冲
+    void flush();
+
+    bool empty() const { return buffer_.empty(); }
+
+    // 取走缓冲内容（管道交接用），不向 fd 写出任何字节
+    std::string takeBuffer()
+    {
+        std::string data;
+        data.swap(buffer_);
+        return data;
+    }
+
+    int fd() const { return fd_; }
+    void setFd(int fd) { fd_ = fd; }
+
+private:
+    std::string buffer_;
+    int fd_;
+};
+
 class CLI
 {
 public:
     CLI();
-    ~CLI() = default;
+    ~CLI();
 
     /**
      * 运行 CLI
-     * - 无参数：进入交互模式
+     * - 无参数且 stdin 是终端：进入交互模式
+     * - 无参数且 stdin 是管道/文件：进入批处理模式（等价于 --batch）
      * - 有参数：执行单条命令后退出
+     * - --batch：从 stdin 流式批量执行命令
+     * - --server[=path]：以服务端模式常驻，通过 Unix 域套接字接收命令
+     * - --client[=path] cmd args...：把命令转发给常驻服务端执行
      */
     int run(int argc, char** argv);
 
+    /**
+     * 批处理模式：大块读取 stdin、原地切行逐条执行。
+     * 不经过 readline，不记历史、不渲染提示符；未知命令
+     * 按行号汇总到 stderr。供 CI / 刷写工位灌入命令脚本使用。
+     *
+     * workers > 1 时脚本行分发到工作线程池并发执行（命令需彼此独立，
+     * 输出须走 out()），每条命令的输出捕获在各自的 OutputSink 里、
+     * 按提交顺序回放；内容为 "%barrier" 的行表示排序栅栏：
+     * 等待之前所有命令完成后才继续。exit/quit 隐含栅栏并串行执行。
+     * @param workers 工作线程数，<=1 为串行
+     * @return 全部命令可识别返回 0，存在未知命令返回 1
+     */
+    int runBatch(unsigned workers = 1);
+
+    /**
+     * 服务端模式：进程常驻，保持已注册的命令表和参数树，
+     * 在 Unix 域套接字上接收 argv 形式的会话（行编辑在客户端完成）。
+     * 并发会话由共享工作池处理：注册表和冻结树都是不可变共享结构，
+     * 16 个诊断会话的内存开销与 1 个几乎相同。会话输出写入各自的
+     * 连接（处理函数须走 out()，线程本地路由同并行批处理）。
+     * @param socketPath 套接字路径
+     * @param workers 会话工作线程数（>=1）
+     * @return 进程退出码
+     */
+    int runServer(const std::string& socketPath, unsigned workers = 4);
+
+    /**
+     * 客户端模式：把 argv 转发给服务端，并把响应原样写到 stdout。
+     * 客户端不注册命令、不安装补全，启动开销只有一次 connect。
+     * @param socketPath 套接字路径
+     * @param args 待执行的命令及参数
+     * @return 0 表示成功转发，非 0 表示连接或传输失败
+     */
+    static int runClient(const std::string& socketPath,
+                         const std::vector<std::string>& args);
+
+    // 默认的服务端套接字路径
+    static constexpr const char* DEFAULT_SOCKET_PATH = "/tmp/carlink-cli.sock";
+
     /**
      * 注册自定义命令（树形依赖参数）
+     *
+     * 所有参数按值接收并向注册表移动：调用方传右值（lambda、临时字符串）
+     * 时名字、描述和三个回调都只构造一次，补全器捕获的大状态不再被复制。
      * @param name 命令名称
      * @param description 命令描述
      * @param handler 命令处理函数
      * @param completer 树形参数补全函数（可选）
      * @param validator 参数验证器（可选）
      */
-    void registerCommand(const std::string& name,
-                         const std::string& description,
+    void registerCommand(std::string name,
+                         std::string description,
                          CommandHandler handler,
                          TreeCompleter completer = nullptr,
                          ParamValidator validator = nullptr);
 
+    /**
+     * 视图版注册：补全函数接收 string_view token，
+     * Tab 补全路径不再为每个 token 分配字符串（见 tokenizeLine）。
+     */
+    void registerCommand(std::string name,
+                         std::string description,
+                         CommandHandler handler,
+                         TreeViewCompleter completer,
+                         ParamValidator validator = nullptr);
+
+    /**
+     * 批量注册用的命令定义；completer / viewCompleter / validator 可为空
+     */
+    struct CommandDef {
+        std::string name;
+        std::string description;
+        CommandHandler handler;
+        TreeCompleter completer;
+        TreeViewCompleter viewCompleter;
+        ParamValidator validator;
+    };
+
+    /**
+     * 批量注册一组命令。与逐条 registerCommand() 等价，
+     * 但整组只触发一次注册表冻结，适合几百条命令的启动注册。
+     */
+    void registerCommands(std::vector<CommandDef> defs);
+
     static bool isCommandRunning();
 
+    /**
+     * 启用持久化命令历史：追加式历史文件 + 环形上界。
+     * 只有交互式会话才会触碰文件：进入 Shell 时以 mmap 方式从文件
+     * 末尾向前取环内的 maxEntries 条（只触碰尾部页面，成本与文件
+     * 总大小无关），之后每条命令增量追加；加载时发现过半内容落在
+     * 环外则原子重写压实。内存侧同样用 maxEntries 约束 readline
+     * 历史，长时间浸泡测试不再无界增长。须在 run() 之前调用。
+     */
+    void setHistoryFile(std::string path, std::size_t maxEntries = 1000);
+
+    /**
+     * 后台执行一条命令，立即返回任务 id（失败返回 -1）。
+     * 交互模式下命令行以 " &" 结尾等价于调用本接口；任务输出捕获在
+     * 各自的缓冲里，完成时在提示符上方打印通知并回放。
+     * 用 jobs 查看在途任务、wait [id] 等待完成。
+     */
+    int submitAsync(const std::vector<std::string>& args);
+
+    /**
+     * 命令输出缓冲。约定处理函数通过 out() 写输出：内容在命令结束时
+     * 由 invokeCommand() 一次性刷出，长输出不再逐行触发系统调用。
+     * 并行批处理时按线程路由到当前任务的捕获缓冲。
+     */
+    OutputSink& out() { return threadSink_ ? *threadSink_ : sink_; }
+
+    /**
+     * 管道输入。作为 "a | b" 的下游执行时返回上游命令的完整输出
+     * （缓冲移动交接，零拷贝、不经过任何进程或文件）；其余情况返回
+     * 空串。与 out() 同为线程本地路由，处理函数无需关心执行环境。
+     */
+    const std::string& in() const { return threadPipeInput_ ? *threadPipeInput_ : emptyPipeInput_; }
+
 private:
     struct CommandInfo;
 
@@ -299,10 +1444,21 @@ private:
     void cmdHelp(const std::vector<std::string>& args);
     void cmdExit(const std::vector<std::string>& args);
     void cmdClear(const std::vector<std::string>& args);
+    void cmdJobs(const std::vector<std::string>& args);
+    void cmdWait(const std::vector<std::string>& args);
+    void cmdStats(const std::vector<std::string>& args);
 
     // 交互式 Shell
     void runInteractiveShell();
 
+    // 持久化历史（见 setHistoryFile）
+    void loadHistoryTail();
+    void appendHistoryLine(const std::string& line);
+    std::string historyPath_;
+    std::size_t historyMaxEntries_ = 0;
+    bool historyLoaded_ = false;
+    int historyFd_ = -1;
+
     // 单命令模式
     void runSingleCommand(const std::vector<std::string>& args);
 
@@ -311,27 +1467,154 @@ private:
     void printPrompt();
     std::vector<std::string> parseCommandLine(const std::string& line);
     bool executeCommand(const std::vector<std::string>& tokens);
+    bool dispatchTokens(const std::vector<std::string>& tokens, bool monitorCtrlD);
     bool invokeCommand(const CommandInfo& info,
                        const std::vector<std::string>& tokens,
                        bool monitorCtrlD);
 
     // Tab 自动补全
     static CLI* instance_;
-    std::vector<std::string> getCommandList() const;
+    std::vector<std::string> getCommandList();
     static char** commandCompletion(const char* text, int start, int end);
     static char* commandGenerator(const char* text, int state);
 
+    /**
+     * 对数刻度延迟直方图：桶 i 计入 [2^i, 2^(i+1)) 微秒的样本，
+     * 最后一桶收尾。记录一次只有两个 relaxed 原子加，可常开。
+     */
+    struct LatencyHistogram {
+        static constexpr std::size_t BUCKET_COUNT = 20;
+        std::atomic<std::uint64_t> buckets[BUCKET_COUNT] = {};
+        std::atomic<std::uint64_t> totalUs{0};
+
+        void record(std::uint64_t us)
+        {
+            std::size_t idx = 0;
+            for (std::uint64_t v = us; v > 1 && idx + 1 < BUCKET_COUNT; v >>= 1) {
+                ++idx;
+            }
+            buckets[idx].fetch_add(1, std::memory_order_relaxed);
+            totalUs.fetch_add(us, std::memory_order_relaxed);
+        }
+    };
+
+    /**
+     * 单命令运行统计。注册时创建，注册表各快照通过 shared_ptr 共享
+     * 同一份计数器：重建注册表既不丢计数也不制造竞态。
+     */
+    struct CommandStats {
+        std::atomic<std::uint64_t> invocations{0};
+        LatencyHistogram validatorUs;
+        LatencyHistogram handlerUs;
+        LatencyHistogram flushUs;
+    };
+
     // 命令注册表
     struct CommandInfo
     {
         std::string description;
         CommandHandler handler;
-        TreeCompleter completer;   // 树形补全函数
-        ParamValidator validator;  // 验证器
+        TreeCompleter completer;           // 树形补全函数（字符串版）
+        TreeViewCompleter viewCompleter;   // 树形补全函数（视图版，优先使用）
+        ParamValidator validator;          // 验证器
+        std::shared_ptr<CommandStats> stats;   // 运行统计（见 cmdStats）
+
+        bool hasCompleter() const { return completer != nullptr || viewCompleter != nullptr; }
+    };
+
+    /**
+     * 冻结的命令注册表：名字与信息平行存放、按字典序排序。
+     * 派发走 string_view 二分查找，不再构造 std::string key，
+     * 也不再为 ~400 条命令付出红黑树的指针追逐。
+     */
+    struct Registry {
+        std::vector<std::string> names;
+        // 各快照共享同一个 CommandInfo：重建只拷贝指针，不深拷贝
+        // 回调和捕获的补全状态
+        std::vector<std::shared_ptr<const CommandInfo>> infos;
+        std::string helpText;   // 预渲染的 help 文本，随快照一起冻结
+
+        const CommandInfo* find(std::string_view name) const;
+    };
+
+    // 取当前注册表快照（read-copy-update 读侧）：无锁原子加载，
+    // 运行期注册/替换命令不会阻塞派发和补全，也不会使快照失效。
+    std::shared_ptr<const Registry> registry() const
+    {
+        return std::atomic_load(&registry_);
+    }
+
+    // 写侧：持 registerMutex_ 重建冻结注册表并原子换入
+    void rebuildRegistryLocked();
+
+    // 注册来源；重建时压实为"每名字最后一次注册"，长期运行中
+    // 服务反复来去重注册也不会无界增长
+    std::vector<std::pair<std::string, std::shared_ptr<const CommandInfo>>> staged_;
+    std::shared_ptr<const Registry> registry_ = std::make_shared<Registry>();
+    std::mutex registerMutex_;   // 只串行化写者（注册路径），读侧无锁
+
+    // Tab 补全复用的分词缓冲，稳态下每次按键零分配
+    std::vector<std::string_view> completionTokens_;
+    std::string completionStorage_;
+
+    // 常驻工作线程：交互命令在它上面执行，避免每条命令创建/销毁线程。
+    // 任何时刻只有一条交互命令在途，单槽位交接即可，锁不会发生竞争。
+    void ensureWorker();
+    void stopWorker();
+    void workerLoop();
+    std::thread worker_;
+    std::mutex workerMutex_;
+    std::condition_variable workerCv_;
+    std::function<void()> workerTask_;
+    bool workerStop_ = false;
+
+    // 跨线程唤醒通道：Linux 用 eventfd（单 fd、读后清零），其他平台
+    // （macOS 等）退回非阻塞自管道；写端递增、读端排空，语义一致
+    struct WakeupChannel {
+        int readFd = -1;
+        int writeFd = -1;
+
+        bool open();
+        void close();
+        bool drain() const;            // 读端排空（非阻塞），有事件返回 true
+        static void signalFd(int fd);  // 写端递增；按 fd 传递便于闭包捕获
+        void signal() const { signalFd(writeFd); }
+    };
+
+    // 命令完成通知：worker 写通道，监控循环与 stdin 一起 poll，
+    // 无需周期性唤醒（见 invokeCommand）
+    WakeupChannel workerDone_;
+
+    // 命令输出缓冲（见 out()）
+    OutputSink sink_;
+
+    // 并行批处理的线程本地输出路由：池内线程执行命令时指向任务缓冲
+    static thread_local OutputSink* threadSink_;
+
+    // 管道输入的线程本地路由（见 in()）
+    static thread_local const std::string* threadPipeInput_;
+    static const std::string emptyPipeInput_;
+
+    // "a | b" 形式的管道：逐阶段执行，上游缓冲移动交接给下游的 in()
+    bool executePipeline(const std::vector<std::vector<std::string>>& stages);
 
-        bool hasCompleter() const { return completer != nullptr; }
+    // 后台任务（submitAsync / "cmd &"；jobs、wait 内置命令）
+    struct Job {
+        int id = 0;
+        std::string command;               // 显示用的原始命令
+        OutputSink sink;                   // 捕获的输出，通知时回放
+        std::atomic<bool> finished{false};
+        bool notified = false;             // 通知与回放是否已打印
+        std::thread thread;
     };
-    std::map<std::string, CommandInfo> commands_;
+    void onJobFinished(Job& job);          // 任务线程：经唤醒通道通知主线程
+    void printJobNotification(Job& job);   // 需持有 jobsMutex_
+    void reapJobs();                       // 主线程：补发通知并回收已完成任务
+    static int jobEventHook();             // 主线程：readline 空闲回调里消费通知
+    std::vector<std::unique_ptr<Job>> jobs_;
+    std::mutex jobsMutex_;
+    int nextJobId_ = 1;
+    WakeupChannel jobNotify_;   // 任务完成通知（非阻塞读）
 
     bool running_;
     std::atomic<bool> commandRunning_{false};
@@ -0,0 +1,216 @@
+/**
+ * carlink_cli 微基准 —— 覆盖热路径：行切分、树构建/冻结、补全下降、
+ * 参数验证、批量注册和大树上的单次补全按键。
+ *
+ * 构建：cmake -DCARLINK_BUILD_BENCH=ON，目标 carlink_cli_bench。
+ * 结果用于跨版本回归追踪，绝对数值以目标硬件上的运行为准。
+ */
+
+#include "CLI.h"
+
+#include <benchmark/benchmark.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace carlink::cli;
+
+namespace {
+
+// 生成 depth 层、每层 fanout 个子节点的满树条目（路径按字典序），
+// 叶子节点带一组候选值。节点总数为 (fanout^(depth+1) - 1) / (fanout - 1)。
+std::vector<TreeBuilder::Entry> makeTreeEntries(int depth, int fanout)
+{
+    std::vector<std::string> keys;
+    keys.reserve(fanout);
+    for (int i = 0; i < fanout; ++i) {
+        char buf[16];
+        std::snprintf(buf, sizeof(buf), "k%03d", i);
+        keys.emplace_back(buf);
+    }
+
+    std::vector<std::string> leafCandidates = {"off", "on", "toggle"};
+
+    std::vector<TreeBuilder::Entry> entries;
+    std::vector<std::string> path;
+    // 深度优先、子节点按 key 序展开，天然满足 load() 要求的字典序
+    std::function<void(int)> descend = [&](int level) {
+        if (level == depth) {
+            entries.push_back(TreeBuilder::Entry{path, leafCandidates, {}});
+            return;
+        }
+        for (const auto& key : keys) {
+            path.push_back(key);
+            descend(level + 1);
+            path.pop_back();
+        }
+    };
+    descend(0);
+    return entries;
+}
+
+std::shared_ptr<const FrozenTree> makeFrozenTree(int depth, int fanout)
+{
+    ParamNode root;
+    TreeBuilder builder(root);
+    builder.load(makeTreeEntries(depth, fanout));
+    return FrozenTree::build(root);
+}
+
+// 到最深层的 token 序列：命令名 + depth 个中间 key + 叶子输入槽
+std::vector<std::string> makePathArgs(int depth, const char* leafValue)
+{
+    std::vector<std::string> args = {"cmd"};
+    for (int i = 0; i < depth; ++i) {
+        args.emplace_back("k000");
+    }
+    args.emplace_back(leafValue);
+    return args;
+}
+
+}  // namespace
+
+// ---- 行切分 -------------------------------------------------------------
+
+static void BM_TokenizeSimple(benchmark::State& state)
+{
+    std::vector<std::string_view> tokens;
+    std::string storage;
+    for (auto _ : state) {
+        tokenizeLine("set device1 light 2 fast", tokens, storage);
+        benchmark::DoNotOptimize(tokens);
+    }
+}
+BENCHMARK(BM_TokenizeSimple);
+
+static void BM_TokenizeQuoted(benchmark::State& state)
+{
+    std::vector<std::string_view> tokens;
+    std::string storage;
+    for (auto _ : state) {
+        tokenizeLine("set \"device one\" 'light mode' esc\\ aped end", tokens, storage);
+        benchmark::DoNotOptimize(tokens);
+    }
+}
+BENCHMARK(BM_TokenizeQuoted);
+
+// ---- 树构建与冻结 -------------------------------------------------------
+
+static void BM_TreeBuildFreeze(benchmark::State& state)
+{
+    const int depth = 3;
+    const int fanout = static_cast<int>(state.range(0));
+    auto entries = makeTreeEntries(depth, fanout);
+    for (auto _ : state) {
+        ParamNode root;
+        TreeBuilder builder(root);
+        builder.load(entries);
+        auto tree = FrozenTree::build(root);
+        benchmark::DoNotOptimize(tree);
+    }
+    state.SetComplexityN(state.range(0));
+}
+BENCHMARK(BM_TreeBuildFreeze)->Arg(4)->Arg(8)->Arg(16)->Complexity();
+
+// ---- 补全下降 -----------------------------------------------------------
+
+static void BM_CompleterDescentDepth(benchmark::State& state)
+{
+    const int depth = static_cast<int>(state.range(0));
+    auto [completer, validator] = makeTreeParamMapView(makeFrozenTree(depth, 4));
+    auto args = makePathArgs(depth, "o");
+    std::vector<std::string_view> tokens(args.begin(), args.end());
+    for (auto _ : state) {
+        auto matches = completer(tokens, static_cast<int>(tokens.size()) - 1, "o");
+        benchmark::DoNotOptimize(matches);
+    }
+}
+BENCHMARK(BM_CompleterDescentDepth)->Arg(2)->Arg(4)->Arg(8);
+
+static void BM_CompleterDescentFanout(benchmark::State& state)
+{
+    const int fanout = static_cast<int>(state.range(0));
+    auto [completer, validator] = makeTreeParamMapView(makeFrozenTree(3, fanout));
+    auto args = makePathArgs(3, "o");
+    std::vector<std::string_view> tokens(args.begin(), args.end());
+    for (auto _ : state) {
+        auto matches = completer(tokens, static_cast<int>(tokens.size()) - 1, "o");
+        benchmark::DoNotOptimize(matches);
+    }
+}
+BENCHMARK(BM_CompleterDescentFanout)->Arg(4)->Arg(16)->Arg(43);
+
+// ---- 参数验证 -----------------------------------------------------------
+
+static void BM_Validator(benchmark::State& state)
+{
+    const int depth = static_cast<int>(state.range(0));
+    auto [completer, validator] = makeTreeParamMapView(makeFrozenTree(depth, 8));
+    auto args = makePathArgs(depth, "on");
+    for (auto _ : state) {
+        auto error = validator(args);
+        benchmark::DoNotOptimize(error);
+    }
+}
+BENCHMARK(BM_Validator)->Arg(2)->Arg(4)->Arg(8);
+
+// ---- 批量注册 -----------------------------------------------------------
+
+static void BM_RegisterCommandsBulk(benchmark::State& state)
+{
+    const int count = static_cast<int>(state.range(0));
+    std::vector<CLI::CommandDef> defs;
+    defs.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        CLI::CommandDef def;
+        def.name = "cmd" + std::to_string(i);
+        def.description = "benchmark command";
+        def.handler = [](const std::vector<std::string>&) {};
+        defs.push_back(std::move(def));
+    }
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto cli = std::make_unique<CLI>();
+        state.ResumeTiming();
+        cli->registerCommands(defs);
+        state.PauseTiming();
+        cli.reset();
+        state.ResumeTiming();
+    }
+}
+BENCHMARK(BM_RegisterCommandsBulk)->Arg(100)->Arg(500)->Arg(2000);
+
+// ---- 大树上的端到端补全按键 ---------------------------------------------
+
+// 深 3 x 扇出 43 = 81400 节点，接近实车信号树的规模。
+// 覆盖游标复用（同路径重复按键）与冷路径（参数给 0 时换路径）。
+static void BM_Completion80kTree(benchmark::State& state)
+{
+    static auto tree = makeFrozenTree(3, 43);
+    auto [completer, validator] = makeTreeParamMapView(tree);
+    std::vector<std::string_view> tokens = {"cmd", "k000", "k021", "k042", "t"};
+    std::vector<std::string_view> altTokens = {"cmd", "k042", "k021", "k000", "t"};
+    const bool alternate = state.range(0) != 0;
+    bool flip = false;
+    for (auto _ : state) {
+        auto matches = completer(alternate && flip ? altTokens : tokens, 4, "t");
+        benchmark::DoNotOptimize(matches);
+        flip = !flip;
+    }
+}
+BENCHMARK(BM_Completion80kTree)->Arg(0)->Arg(1);
+
+static void BM_Completion80kTreeFuzzy(benchmark::State& state)
+{
+    static auto tree = makeFrozenTree(3, 43);
+    auto [completer, validator] = makeTreeParamMapView(tree, MatchMode::Fuzzy);
+    std::vector<std::string_view> tokens = {"cmd", "k000", "k021", "k042", "tg"};
+    for (auto _ : state) {
+        auto matches = completer(tokens, 4, "tg");
+        benchmark::DoNotOptimize(matches);
+    }
+}
+BENCHMARK(BM_Completion80kTreeFuzzy);
+
+BENCHMARK_MAIN();